@@ -0,0 +1,77 @@
+/**
+ * \file varikey_allocation.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include "varikey_allocation.hpp"
+
+#ifdef VARIKEY_ALLOCATION_COUNTING
+
+static thread_local uint64_t allocations = 0;
+
+void *operator new(std::size_t _size)
+{
+    ++allocations;
+    void *memory = std::malloc(_size ? _size : 1);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](std::size_t _size)
+{
+    return operator new(_size);
+}
+
+void *operator new(std::size_t _size, const std::nothrow_t &) noexcept
+{
+    ++allocations;
+    return std::malloc(_size ? _size : 1);
+}
+
+void *operator new[](std::size_t _size, const std::nothrow_t &) noexcept
+{
+    return operator new(_size, std::nothrow);
+}
+
+void operator delete(void *_memory) noexcept { std::free(_memory); }
+void operator delete[](void *_memory) noexcept { std::free(_memory); }
+void operator delete(void *_memory, std::size_t) noexcept { std::free(_memory); }
+void operator delete[](void *_memory, std::size_t) noexcept { std::free(_memory); }
+
+#endif
+
+namespace varikey
+{
+    namespace allocation
+    {
+        bool enabled()
+        {
+#ifdef VARIKEY_ALLOCATION_COUNTING
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * \brief allocations made by the calling thread so far
+         */
+        uint64_t count()
+        {
+#ifdef VARIKEY_ALLOCATION_COUNTING
+            return allocations;
+#else
+            return 0;
+#endif
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * \file varikey_allocation.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_ALLOCATION_HPP__
+#define __VARIKEY_ALLOCATION_HPP__
+
+#include <cstdint>
+
+namespace varikey
+{
+    /**
+     * \brief heap allocation accounting
+     *
+     * Built with VARIKEY_ALLOCATION_COUNTING the global operator new
+     * counts the allocations of every thread, a scope around an operation
+     * tells how many it made. Without the flag nothing is replaced and
+     * every count is 0.
+     */
+    namespace allocation
+    {
+        bool enabled();
+        uint64_t count();
+
+        class scope
+        {
+        public:
+            scope() : start(count()) {}
+            uint64_t get() const { return count() - start; }
+
+        private:
+            const uint64_t start;
+        };
+    }
+}
+
+#endif /* __VARIKEY_ALLOCATION_HPP__ */
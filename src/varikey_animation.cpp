@@ -0,0 +1,194 @@
+/**
+ * \file varikey_animation.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+
+#include "varikey_animation.hpp"
+
+namespace varikey
+{
+    /**
+     * \brief start a sequence, the first frame is drawn with the next tick
+     *
+     * @param frames icons and durations, copied
+     * @param count number of frames
+     * @param mode loop or play once
+     * @param priority a playing sequence with a higher priority is kept
+     * @return false if the sequence is invalid or rejected
+     */
+    bool animation::play(const frame *_frames, const size_t _count, const mode _mode, const uint8_t _priority)
+    {
+        if (_count == 0 || _count > VARIKEY_ANIMATION_FRAMES)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < _count; ++i)
+        {
+            if (_frames[i].duration == 0)
+            {
+                return false;
+            }
+        }
+
+        if (playing)
+        {
+            if (_priority < priority)
+            {
+                ++statistic.rejected;
+                return false;
+            }
+            ++statistic.preempted;
+        }
+
+        std::copy(_frames, _frames + _count, sequence);
+        count = _count;
+        repeat = _mode;
+        priority = _priority;
+        position = 0;
+        due = 0;
+        playing = true;
+        return true;
+    }
+
+    /**
+     * \brief stop playing, the shown icon stays on the gadget
+     */
+    void animation::cancel()
+    {
+        if (playing)
+        {
+            playing = false;
+            ++statistic.cancelled;
+        }
+    }
+
+    /**
+     * \brief show the frame due at now
+     *
+     * @param gadget open gadget
+     * @param now CLOCK_MONOTONIC time in ns
+     * @return size_t number of drawn icons
+     */
+    size_t animation::tick(gadget::usb &_gadget, const uint64_t _now)
+    {
+        if (!playing || !_gadget.is_open())
+        {
+            return 0;
+        }
+
+        if (due == 0)
+        {
+            due = _now + sequence[0].duration;
+            ++statistic.frames;
+            return show(_gadget);
+        }
+
+        if (_now < due)
+        {
+            /* retry a frame the gadget missed */
+            return (shown == 0xff) ? show(_gadget) : 0;
+        }
+
+        uint64_t start = due;
+        if (repeat == mode::LOOP)
+        {
+            /* whole cycles behind are skipped at once */
+            uint64_t cycle = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                cycle += sequence[i].duration;
+            }
+            const uint64_t cycles = (_now - start) / cycle;
+            start += cycles * cycle;
+            statistic.skipped += cycles * count;
+        }
+
+        for (;;)
+        {
+            if (++position == count)
+            {
+                if (repeat == mode::ONCE)
+                {
+                    playing = false;
+                    ++statistic.completed;
+                    return 0;
+                }
+                position = 0;
+            }
+            if (_now < start + sequence[position].duration)
+            {
+                break;
+            }
+            start += sequence[position].duration;
+            ++statistic.skipped;
+        }
+
+        const uint64_t lateness = _now - start;
+        statistic.lateness_total += lateness;
+        statistic.lateness_max = std::max(statistic.lateness_max, lateness);
+        ++statistic.frames;
+
+        due = start + sequence[position].duration;
+        return show(_gadget);
+    }
+
+    /**
+     * \brief redraw the current frame with the next tick
+     *
+     * used after a reset or reconnect, the gadget lost the shown icon
+     */
+    void animation::invalidate()
+    {
+        shown = 0xff;
+    }
+
+    /**
+     * \brief time of the next tick for a one-shot timer
+     *
+     * the end of the current frame, sooner while a missed frame waits for
+     * its retry
+     *
+     * @param now CLOCK_MONOTONIC time in ns
+     * @return due time in ns, 0 if nothing is playing
+     */
+    uint64_t animation::get_next(const uint64_t _now) const
+    {
+        if (!playing)
+        {
+            return 0;
+        }
+        if (due == 0)
+        {
+            return _now;
+        }
+        return (shown == 0xff) ? std::min<uint64_t>(due, _now + VARIKEY_ANIMATION_RETRY) : due;
+    }
+
+    /**
+     * \brief draw the current frame unless the gadget already shows it
+     *
+     * @return size_t 1 if an icon report was sent
+     */
+    size_t animation::show(gadget::usb &_gadget)
+    {
+        const uint8_t icon = sequence[position].icon;
+        if (icon == shown)
+        {
+            return 0;
+        }
+
+        /* a failed frame is retried with the next tick */
+        shown = (_gadget.draw_icon(icon) == gadget::status::SUCCESS) ? icon : 0xff;
+        if (shown == 0xff)
+        {
+            return 0;
+        }
+        ++statistic.reports;
+        return 1;
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * \file varikey_animation.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_ANIMATION_HPP__
+#define __VARIKEY_ANIMATION_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "varikey_gadget_usb.hpp"
+
+/**
+ * \brief animation limits
+ * @{
+ */
+#define VARIKEY_ANIMATION_FRAMES 32 /* frames per sequence */
+#define VARIKEY_ANIMATION_RETRY 10000000ULL /* ns until a missed frame is drawn again */
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief icon sequence player
+     *
+     * Plays a sequence of predefined icons, each shown for its own
+     * duration, on an open gadget. Frames are due at absolute times from
+     * the start of the sequence, so a late tick delays one frame but the
+     * sequence does not drift; a player that fell behind by more than a
+     * frame skips to the current one. A frame repeating the shown icon
+     * sends no report.
+     *
+     * A new sequence preempts the playing one unless it has a lower
+     * priority. play, cancel and tick run on one thread, usually the
+     * reactor thread serving the gadget.
+     */
+    class animation
+    {
+    public:
+        enum class mode : uint8_t
+        {
+            LOOP,
+            ONCE,
+        };
+
+        struct frame
+        {
+            uint8_t icon;
+            uint64_t duration; /* ns */
+        };
+
+        struct counters
+        {
+            uint64_t frames;    /* shown frames */
+            uint64_t reports;   /* drawn icons, held icons are not redrawn */
+            uint64_t skipped;   /* frames passed while behind */
+            uint64_t completed; /* one-shot sequences played to the end */
+            uint64_t preempted;
+            uint64_t rejected;  /* lower priority than the playing sequence */
+            uint64_t cancelled;
+            uint64_t lateness_total; /* ns from frame start to its tick, first frames count 0 */
+            uint64_t lateness_max;
+        };
+
+        animation() {}
+        virtual ~animation() {}
+
+        bool play(const frame *frames, const size_t count, const mode, const uint8_t priority = 0);
+        void cancel();
+
+        size_t tick(gadget::usb &, const uint64_t now);
+        void invalidate();
+        uint64_t get_next(const uint64_t now) const;
+
+        bool is_playing() const { return playing; }
+        uint8_t get_priority() const { return priority; }
+        const counters &get_counters() const { return statistic; }
+
+    private:
+        size_t show(gadget::usb &);
+
+        frame sequence[VARIKEY_ANIMATION_FRAMES];
+        size_t count{0};
+        mode repeat{mode::LOOP};
+        uint8_t priority{0};
+        bool playing{false};
+
+        size_t position{0};
+        uint64_t due{0};      /* end of the current frame, 0 before the first */
+        uint8_t shown{0xff};  /* icon on the gadget, 0xff unknown */
+
+        counters statistic{};
+    };
+}
+
+#endif /* __VARIKEY_ANIMATION_HPP__ */
@@ -0,0 +1,413 @@
+/**
+ * \file varikey_binding.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "varikey_binding.hpp"
+
+/**
+ * \brief multiplicative hash of a device unique
+ */
+#define BINDING_HASH(unique) ((unique) * 2654435761U)
+
+static void trim(std::string &);
+
+namespace varikey
+{
+    binding::binding() {}
+
+    binding::~binding()
+    {
+        for (auto i : fifo_handle)
+        {
+            close(i);
+        }
+    }
+
+    /**
+     * \brief load and compile a binding table
+     *
+     * @param table_path table file
+     * @return true if the whole table is valid
+     */
+    bool binding::load(const char *_table_path)
+    {
+        std::ifstream input(_table_path);
+        if (!input.is_open())
+        {
+            std::cerr << "unable to open binding table " << _table_path << std::endl;
+            return false;
+        }
+
+        std::vector<rule> parsed;
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(input, line))
+        {
+            ++line_number;
+            trim(line);
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            rule item;
+            if (!parse_rule(line, item))
+            {
+                std::cerr << _table_path << ":" << line_number << ": invalid binding" << std::endl;
+                return false;
+            }
+            parsed.push_back(item);
+        }
+
+        compile(parsed);
+        return rules > 0;
+    }
+
+    /**
+     * \brief run the actions bound to an input event
+     *
+     * device rules take precedence over wildcard rules
+     *
+     * @param unique device unique
+     * @param event input event
+     * @param gadget open gadget receiving the commands
+     * @return size_t number of executed actions
+     */
+    size_t binding::dispatch(const uint32_t _unique, const input::event &_event, gadget::usb &_gadget)
+    {
+        const size_t event = event_slot(_event);
+        if (event >= VARIKEY_BINDING_EVENTS || table.empty())
+        {
+            return 0;
+        }
+
+        const size_t device = device_slot(_unique);
+        range selected = table[device * VARIKEY_BINDING_EVENTS + event];
+        if (selected.count == 0 && device != 0)
+        {
+            selected = table[event];
+        }
+
+        for (uint32_t i = selected.first; i < selected.first + selected.count; ++i)
+        {
+            const action &item = actions[i];
+            switch (item.type)
+            {
+            case action_type::ICON:
+                _gadget.draw_icon(item.value[0]);
+                break;
+            case action_type::COLOR:
+                _gadget.set_backlight_color(item.value[0], item.value[1], item.value[2]);
+                break;
+            case action_type::BACKLIGHT:
+                _gadget.set_backlight_mode(item.value[0]);
+                break;
+            case action_type::TEXT:
+            {
+                command commands[] = {encode_font_size(item.value[2]),
+                                      encode_position(item.value[0], item.value[1]),
+                                      encode_text(item.text)};
+                _gadget.send_commands(commands, 3);
+                break;
+            }
+            case action_type::FIFO:
+                /* non blocking, a full fifo drops the message */
+                if (write(item.fifo_handle, item.text, item.length) < 0)
+                {
+                    ++fifo_dropped;
+                }
+                break;
+            }
+        }
+
+        return selected.count;
+    }
+
+    /**
+     * \brief parse "UNIQUE|* EVENT ARGUMENT : ACTION [; ACTION ...]"
+     */
+    bool binding::parse_rule(const std::string &_line, rule &_rule)
+    {
+        const size_t separator = _line.find(':');
+        if (separator == std::string::npos)
+        {
+            return false;
+        }
+
+        std::istringstream trigger(_line.substr(0, separator));
+        std::string device, event, argument;
+        if (!(trigger >> device >> event >> argument))
+        {
+            return false;
+        }
+
+        _rule.wildcard = (device == "*");
+        _rule.unique = _rule.wildcard ? 0 : std::strtoul(device.c_str(), nullptr, 0);
+        if (!_rule.wildcard && _rule.unique == 0)
+        {
+            return false;
+        }
+
+        if (event == "press" || event == "release")
+        {
+            const unsigned long code = std::strtoul(argument.c_str(), nullptr, 0);
+            if (code == 0 || code > 0xff)
+            {
+                return false;
+            }
+            _rule.event = ((event == "press") ? VARIKEY_BINDING_PRESS : VARIKEY_BINDING_RELEASE) + code;
+        }
+        else if (event == "encoder" && (argument == "+" || argument == "-"))
+        {
+            _rule.event = VARIKEY_BINDING_ENCODER + ((argument == "+") ? 0 : 1);
+        }
+        else
+        {
+            return false;
+        }
+
+        std::istringstream list(_line.substr(separator + 1));
+        std::string text;
+        while (std::getline(list, text, ';'))
+        {
+            trim(text);
+            action item;
+            if (!parse_action(text, item))
+            {
+                return false;
+            }
+            _rule.actions.push_back(item);
+        }
+
+        return !_rule.actions.empty();
+    }
+
+    bool binding::parse_action(const std::string &_text, action &_action)
+    {
+        memset(&_action, 0, sizeof(_action));
+        _action.fifo_handle = -1;
+
+        std::istringstream tokens(_text);
+        std::string keyword;
+        if (!(tokens >> keyword))
+        {
+            return false;
+        }
+
+        std::string rest;
+        if (keyword == "icon" || keyword == "backlight")
+        {
+            int value;
+            if (!(tokens >> value))
+            {
+                return false;
+            }
+            _action.type = (keyword == "icon") ? action_type::ICON : action_type::BACKLIGHT;
+            _action.value[0] = static_cast<uint8_t>(value);
+        }
+        else if (keyword == "color")
+        {
+            std::string color;
+            if (!(tokens >> color) || color.length() != 6)
+            {
+                return false;
+            }
+            char *end = nullptr;
+            unsigned long value = std::strtoul(color.c_str(), &end, 16);
+            if (*end != '\0')
+            {
+                return false;
+            }
+            _action.type = action_type::COLOR;
+            _action.value[0] = (value >> 16) & 0xff;
+            _action.value[1] = (value >> 8) & 0xff;
+            _action.value[2] = value & 0xff;
+        }
+        else if (keyword == "text")
+        {
+            int line, column, font_size;
+            if (!(tokens >> line >> column >> font_size))
+            {
+                return false;
+            }
+            std::getline(tokens >> std::ws, rest);
+            _action.type = action_type::TEXT;
+            _action.value[0] = static_cast<uint8_t>(line);
+            _action.value[1] = static_cast<uint8_t>(column);
+            _action.value[2] = static_cast<uint8_t>(font_size);
+        }
+        else if (keyword == "fifo")
+        {
+            std::string path;
+            if (!(tokens >> path))
+            {
+                return false;
+            }
+            std::getline(tokens >> std::ws, rest);
+            rest.push_back('\n');
+            _action.type = action_type::FIFO;
+            _action.fifo_handle = open_fifo(path);
+            if (_action.fifo_handle < 0)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+
+        const size_t length = std::min(rest.length(), sizeof(_action.text) - 1);
+        memcpy(_action.text, rest.data(), length);
+        _action.length = static_cast<uint8_t>(length);
+        return true;
+    }
+
+    /**
+     * \brief open a fifo once, shared by all actions writing to it
+     *
+     * read-write open does not fail or block without a reader
+     */
+    int binding::open_fifo(const std::string &_path)
+    {
+        for (size_t i = 0; i < fifo_path.size(); ++i)
+        {
+            if (fifo_path[i] == _path)
+            {
+                return fifo_handle[i];
+            }
+        }
+
+        int handle = open(_path.c_str(), O_RDWR | O_NONBLOCK);
+        if (handle < 0)
+        {
+            fprintf(stderr, "unable to open fifo %s: %d %s\n", _path.c_str(), errno, strerror(errno));
+            return -1;
+        }
+
+        fifo_path.push_back(_path);
+        fifo_handle.push_back(handle);
+        return handle;
+    }
+
+    /**
+     * \brief build device hash, event table and flat action array
+     */
+    void binding::compile(std::vector<rule> &_rules)
+    {
+        std::vector<uint32_t> uniques;
+        for (auto const &i : _rules)
+        {
+            if (!i.wildcard && std::find(uniques.begin(), uniques.end(), i.unique) == uniques.end())
+            {
+                uniques.push_back(i.unique);
+            }
+        }
+
+        /* slot 0 is the wildcard, an empty hash entry has slot 0 */
+        size_t capacity = 4;
+        while (capacity < uniques.size() * 2)
+        {
+            capacity <<= 1;
+        }
+        hash_mask = capacity - 1;
+        hash_unique.assign(capacity, 0);
+        hash_slot.assign(capacity, 0);
+        for (size_t i = 0; i < uniques.size(); ++i)
+        {
+            uint32_t index = BINDING_HASH(uniques[i]) & hash_mask;
+            while (hash_slot[index] != 0)
+            {
+                index = (index + 1) & hash_mask;
+            }
+            hash_unique[index] = uniques[i];
+            hash_slot[index] = i + 1;
+        }
+
+        std::stable_sort(_rules.begin(), _rules.end(), [this](const rule &a, const rule &b)
+                         {
+                             const size_t first = a.wildcard ? 0 : device_slot(a.unique);
+                             const size_t second = b.wildcard ? 0 : device_slot(b.unique);
+                             return (first != second) ? first < second : a.event < b.event; });
+
+        table.assign((uniques.size() + 1) * VARIKEY_BINDING_EVENTS, {0, 0});
+        actions.clear();
+        for (auto const &i : _rules)
+        {
+            const size_t device = i.wildcard ? 0 : device_slot(i.unique);
+            range &entry = table[device * VARIKEY_BINDING_EVENTS + i.event];
+            if (entry.count == 0)
+            {
+                entry.first = actions.size();
+            }
+            entry.count += i.actions.size();
+            actions.insert(actions.end(), i.actions.begin(), i.actions.end());
+        }
+
+        rules = _rules.size();
+    }
+
+    /**
+     * \brief table column of an event
+     */
+    size_t binding::event_slot(const input::event &_event)
+    {
+        switch (_event.kind)
+        {
+        case input::type::KEY_PRESS:
+            return VARIKEY_BINDING_PRESS + _event.code;
+        case input::type::KEY_RELEASE:
+            return VARIKEY_BINDING_RELEASE + _event.code;
+        case input::type::ENCODER:
+            return VARIKEY_BINDING_ENCODER + ((_event.value > 0) ? 0 : 1);
+        }
+        return VARIKEY_BINDING_EVENTS;
+    }
+
+    /**
+     * \brief table row of a device, 0 for unbound devices
+     */
+    size_t binding::device_slot(const uint32_t _unique) const
+    {
+        if (hash_slot.empty())
+        {
+            return 0;
+        }
+
+        uint32_t index = BINDING_HASH(_unique) & hash_mask;
+        while (hash_slot[index] != 0)
+        {
+            if (hash_unique[index] == _unique)
+            {
+                return hash_slot[index];
+            }
+            index = (index + 1) & hash_mask;
+        }
+        return 0;
+    }
+}
+
+/**
+ * \brief remove leading and trailing blanks
+ */
+static void trim(std::string &_text)
+{
+    const size_t begin = _text.find_first_not_of(" \t\r\n");
+    const size_t end = _text.find_last_not_of(" \t\r\n");
+    _text = (begin == std::string::npos) ? std::string() : _text.substr(begin, end - begin + 1);
+}
@@ -0,0 +1,119 @@
+/**
+ * \file varikey_binding.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_BINDING_HPP__
+#define __VARIKEY_BINDING_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "varikey_command.hpp"
+#include "varikey_gadget_usb.hpp"
+#include "varikey_input.hpp"
+
+/**
+ * \brief event slots of a device: key press, key release, encoder
+ * @{
+ */
+#define VARIKEY_BINDING_PRESS 0
+#define VARIKEY_BINDING_RELEASE 256
+#define VARIKEY_BINDING_ENCODER 512
+#define VARIKEY_BINDING_EVENTS 514
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief host side key to action binding
+     *
+     * A binding table maps (device unique, input event) to a sequence of
+     * actions. One rule per line, "*" binds all devices without own rule:
+     *
+     *   # comment
+     *   UNIQUE|* press|release CODE : ACTION [; ACTION ...]
+     *   UNIQUE|* encoder +|- : ACTION [; ACTION ...]
+     *
+     * Actions are "icon ICON", "color RRGGBB", "backlight MODE",
+     * "text LINE COLUMN FONT TEXT" and "fifo PATH MESSAGE".
+     *
+     * The table is compiled on load into a flat array indexed by device
+     * slot and event slot. Dispatch is a hash probe plus an array lookup,
+     * it does not allocate and may run directly on the input read path,
+     * also on several reactor threads at once.
+     */
+    class binding
+    {
+    public:
+        binding();
+        virtual ~binding();
+
+        bool load(const char *table_path);
+        size_t dispatch(const uint32_t unique, const input::event &, gadget::usb &);
+
+        size_t get_rule_count() const { return rules; }
+        uint64_t get_fifo_dropped() const { return fifo_dropped; }
+
+    private:
+        enum class action_type : uint8_t
+        {
+            ICON,
+            COLOR,
+            BACKLIGHT,
+            TEXT,
+            FIFO,
+        };
+
+        struct action
+        {
+            action_type type;
+            uint8_t value[3]; /* icon, mode, rgb or line, column, font */
+            int fifo_handle;
+            uint8_t length;
+            char text[VARIKEY_TEXT_SIZE];
+        };
+
+        struct range
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        struct rule
+        {
+            uint32_t unique;
+            bool wildcard;
+            uint32_t event;
+            std::vector<action> actions;
+        };
+
+        bool parse_rule(const std::string &, rule &);
+        bool parse_action(const std::string &, action &);
+        int open_fifo(const std::string &path);
+        void compile(std::vector<rule> &);
+
+        static size_t event_slot(const input::event &);
+        size_t device_slot(const uint32_t unique) const;
+
+        std::vector<range> table;
+        std::vector<action> actions;
+
+        std::vector<uint32_t> hash_unique;
+        std::vector<uint32_t> hash_slot;
+        uint32_t hash_mask{0};
+
+        std::vector<std::string> fifo_path;
+        std::vector<int> fifo_handle;
+
+        size_t rules{0};
+        std::atomic<uint64_t> fifo_dropped{0}; /* dispatch may run on several reactors */
+    };
+}
+
+#endif /* __VARIKEY_BINDING_HPP__ */
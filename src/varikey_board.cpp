@@ -0,0 +1,424 @@
+/**
+ * \file varikey_board.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "varikey_board.hpp"
+#include "varikey_rate.hpp"
+
+static void board_name(char (&name)[VARIKEY_BOARD_NAME_SIZE], const uint32_t unique);
+static uint32_t settle(std::atomic<uint32_t> &sequence);
+
+namespace varikey
+{
+    board::board() {}
+
+    board::~board()
+    {
+        detach();
+    }
+
+    /**
+     * \brief map the board segment of a device, create it if necessary
+     *
+     * @param unique device unique identifier
+     * @param mode permissions of a created segment, an existing one keeps its own
+     * @return true on success
+     */
+    bool board::attach(const uint32_t _unique, const mode_t _mode)
+    {
+        detach();
+
+        char name[VARIKEY_BOARD_NAME_SIZE];
+        board_name(name, _unique);
+
+        int handle = shm_open(name, O_RDWR | O_CREAT, _mode);
+        if (handle < 0)
+        {
+            fprintf(stderr, "error opening board %s: %d %s\n", name, errno, strerror(errno));
+            return false;
+        }
+
+        if (ftruncate(handle, sizeof(shared)) < 0)
+        {
+            fprintf(stderr, "error sizing board %s: %d %s\n", name, errno, strerror(errno));
+            close(handle);
+            return false;
+        }
+
+        void *memory = mmap(nullptr, sizeof(shared), PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+        close(handle);
+        if (memory == MAP_FAILED)
+        {
+            fprintf(stderr, "error mapping board %s: %d %s\n", name, errno, strerror(errno));
+            return false;
+        }
+
+        /* a fresh segment is zero filled, mark it once */
+        layout = static_cast<shared *>(memory);
+        if (layout->magic != VARIKEY_BOARD_MAGIC)
+        {
+            write_lock();
+            layout->magic = VARIKEY_BOARD_MAGIC;
+            write_unlock();
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief unmap board segment
+     */
+    void board::detach()
+    {
+        if (layout != nullptr)
+        {
+            munmap(layout, sizeof(shared));
+            layout = nullptr;
+        }
+    }
+
+    /**
+     * \brief remove the board segment of a device
+     */
+    void board::remove(const uint32_t _unique)
+    {
+        char name[VARIKEY_BOARD_NAME_SIZE];
+        board_name(name, _unique);
+        shm_unlink(name);
+    }
+
+    /**
+     * \brief post a display line
+     */
+    void board::post_text(const int _line, const int _column, const int _font_size, const char *_text)
+    {
+        if (layout == nullptr || _line < 0 || _line >= VARIKEY_BOARD_LINES)
+        {
+            return;
+        }
+
+        state &data = write_lock();
+        auto &line = data.line[_line];
+        line.column = _column;
+        line.font_size = _font_size;
+        strncpy(line.text, _text, sizeof(line.text) - 1);
+        line.text[sizeof(line.text) - 1] = '\0';
+        ++data.generation[LINE_0 + _line];
+        write_unlock();
+    }
+
+    /**
+     * \brief post an icon identifier
+     */
+    void board::post_icon(const int _icon)
+    {
+        if (layout == nullptr)
+        {
+            return;
+        }
+
+        state &data = write_lock();
+        data.icon = _icon;
+        ++data.generation[ICON];
+        write_unlock();
+    }
+
+    /**
+     * \brief post a backlight mode
+     */
+    void board::post_backlight_mode(const int _mode)
+    {
+        if (layout == nullptr)
+        {
+            return;
+        }
+
+        state &data = write_lock();
+        data.backlight.mode = _mode;
+        ++data.generation[BACKLIGHT];
+        write_unlock();
+    }
+
+    /**
+     * \brief post a backlight color
+     */
+    void board::post_backlight_color(const uint8_t _r, const uint8_t _g, const uint8_t _b)
+    {
+        if (layout == nullptr)
+        {
+            return;
+        }
+
+        state &data = write_lock();
+        data.backlight.mode = 0xaa;
+        data.backlight.r = _r;
+        data.backlight.g = _g;
+        data.backlight.b = _b;
+        ++data.generation[BACKLIGHT];
+        write_unlock();
+    }
+
+    /**
+     * \brief current seqlock value, changes with every post
+     */
+    uint32_t board::get_sequence() const
+    {
+        return (layout != nullptr) ? layout->sequence.load(std::memory_order_acquire) : 0;
+    }
+
+    /**
+     * \brief take a consistent copy of the board
+     *
+     * @return false if the board is not attached or kept changing
+     * during VARIKEY_BOARD_RETRIES copies
+     */
+    bool board::snapshot(state &_copy) const
+    {
+        if (layout == nullptr)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < VARIKEY_BOARD_RETRIES; ++i)
+        {
+            const uint32_t begin = settle(layout->sequence);
+            memcpy(&_copy, &layout->data, sizeof(_copy));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (layout->sequence.load(std::memory_order_relaxed) == begin)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief enter the writer side of the seqlock
+     *
+     * the odd sequence value serializes concurrent producers
+     */
+    board::state &board::write_lock()
+    {
+        uint32_t value = settle(layout->sequence);
+        while (!layout->sequence.compare_exchange_weak(value, value + 1, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            value = settle(layout->sequence);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        return layout->data;
+    }
+
+    /**
+     * \brief leave the writer side of the seqlock
+     */
+    void board::write_unlock()
+    {
+        layout->sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    board_driver::board_driver(board &_source, gadget::usb &_gadget) : source(_source), gadget(_gadget) {}
+
+    board_driver::~board_driver()
+    {
+        stop();
+    }
+
+    /**
+     * \brief start the driver thread
+     *
+     * @param interval generation check period in milliseconds
+     */
+    void board_driver::start(const uint32_t _interval)
+    {
+        if (running)
+        {
+            return;
+        }
+
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+
+        /* the gadget font is unknown after a reconnect */
+        font_size = 0xff;
+        running = true;
+        worker = std::thread(&board_driver::run, this, _interval);
+    }
+
+    /**
+     * \brief stop the driver thread
+     */
+    void board_driver::stop()
+    {
+        running = false;
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * \brief send all fields changed since the last flush
+     *
+     * posts between two flushes collapse into a single update; a field
+     * counts as sent only once the gadget took it
+     *
+     * @return size_t number of sent fields
+     */
+    size_t board_driver::flush()
+    {
+        board::state data;
+        pending = true;
+        if (!source.snapshot(data))
+        {
+            return 0;
+        }
+        pending = false;
+
+        size_t sent = 0;
+        for (int i = 0; i < board::FIELD_COUNT && gadget.is_open(); ++i)
+        {
+            if (data.generation[i] == generation[i])
+            {
+                continue;
+            }
+
+            gadget::status result = gadget::status::SUCCESS;
+            switch (i)
+            {
+            case board::ICON:
+                result = gadget.draw_icon(data.icon);
+                break;
+            case board::BACKLIGHT:
+                if (data.backlight.mode == 0xaa)
+                {
+                    result = gadget.set_backlight_color(data.backlight.r, data.backlight.g, data.backlight.b);
+                }
+                else
+                {
+                    result = gadget.set_backlight_mode(data.backlight.mode);
+                }
+                break;
+            default:
+            {
+                const auto &line = data.line[i - board::LINE_0];
+                command commands[3];
+                size_t count = 0;
+                if (line.font_size != font_size)
+                {
+                    commands[count++] = encode_font_size(line.font_size);
+                }
+                commands[count++] = encode_position(i - board::LINE_0, line.column);
+                commands[count++] = encode_text(line.text);
+                result = gadget.send_commands(commands, count);
+                if (result == gadget::status::SUCCESS)
+                {
+                    font_size = line.font_size;
+                }
+            }
+            break;
+            }
+
+            /* a failed field keeps its old generation and is sent again */
+            if (result != gadget::status::SUCCESS)
+            {
+                font_size = 0xff;
+                pending = true;
+                continue;
+            }
+            generation[i] = data.generation[i];
+            ++sent;
+        }
+
+        ++flushes;
+        fields += sent;
+        return sent;
+    }
+
+    void board_driver::run(const uint32_t _interval)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        while (running && gadget.is_open())
+        {
+            uint32_t current = source.get_sequence();
+            if (current != sequence && !(current & 1))
+            {
+                /* an incomplete flush is repeated with the next period */
+                flush();
+                if (!pending)
+                {
+                    sequence = current;
+                }
+            }
+
+            deadline.tv_nsec += static_cast<long>(_interval % 1000) * 1000000L;
+            deadline.tv_sec += _interval / 1000 + deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+        }
+
+        running = false;
+    }
+}
+
+/**
+ * \brief shared memory object name of a device board
+ */
+static void board_name(char (&_name)[VARIKEY_BOARD_NAME_SIZE], const uint32_t _unique)
+{
+    snprintf(_name, sizeof(_name), "/varikey-board-%u", _unique);
+}
+
+/**
+ * \brief wait for an even seqlock value
+ *
+ * polls, then yields; a value staying odd for VARIKEY_BOARD_STALE
+ * belongs to a producer that died inside a post and is released, the
+ * fields it was writing may be torn
+ */
+static uint32_t settle(std::atomic<uint32_t> &_sequence)
+{
+    uint32_t value = _sequence.load(std::memory_order_acquire);
+    uint32_t stuck = value;
+    uint64_t since = 0;
+
+    for (uint32_t polls = 0; value & 1; value = _sequence.load(std::memory_order_acquire))
+    {
+        if (++polls < VARIKEY_BOARD_SPINS)
+        {
+            continue;
+        }
+        std::this_thread::yield();
+
+        const uint64_t now = varikey::rate_controller::now();
+        if (value != stuck || since == 0)
+        {
+            stuck = value;
+            since = now;
+        }
+        else if (now - since > VARIKEY_BOARD_STALE)
+        {
+            /* fails harmlessly if the writer finished meanwhile */
+            _sequence.compare_exchange_strong(value, value + 1, std::memory_order_acq_rel, std::memory_order_acquire);
+            since = 0;
+        }
+    }
+    return value;
+}
@@ -0,0 +1,139 @@
+/**
+ * \file varikey_board.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_BOARD_HPP__
+#define __VARIKEY_BOARD_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+#include <thread>
+
+#include "varikey_command.hpp"
+#include "varikey_gadget_usb.hpp"
+
+#define VARIKEY_BOARD_LINES 4
+#define VARIKEY_BOARD_MAGIC 0x56424431 /* VBD1 */
+#define VARIKEY_BOARD_NAME_SIZE 32
+#define VARIKEY_BOARD_MODE 0600          /* segment permissions, 0660 shares the board with the group */
+#define VARIKEY_BOARD_SPINS 1024         /* busy polls of an odd sequence before yielding */
+#define VARIKEY_BOARD_RETRIES 64         /* torn snapshot copies before giving up */
+#define VARIKEY_BOARD_STALE 1000000000ULL /* ns an odd sequence may last before its writer counts as dead */
+
+namespace varikey
+{
+    /**
+     * \brief shared memory status board of a gadget
+     *
+     * Local producers post display lines, icon and backlight into a
+     * shared memory segment per device unique. Posting is a memcpy under
+     * a seqlock without any system call; the segment is mapped once on
+     * attach. A board driver flushes the changed fields to the gadget.
+     */
+    class board
+    {
+    public:
+        enum field : uint8_t
+        {
+            LINE_0 = 0,
+            LINE_1,
+            LINE_2,
+            LINE_3,
+            ICON,
+            BACKLIGHT,
+            FIELD_COUNT,
+        };
+
+        struct state
+        {
+            uint32_t generation[FIELD_COUNT];
+            struct
+            {
+                uint8_t column;
+                uint8_t font_size;
+                char text[VARIKEY_TEXT_SIZE];
+            } line[VARIKEY_BOARD_LINES];
+            uint8_t icon;
+            struct
+            {
+                uint8_t mode; /* 0xaa for rgb color */
+                uint8_t r;
+                uint8_t g;
+                uint8_t b;
+            } backlight;
+        };
+
+        board();
+        virtual ~board();
+
+        bool attach(const uint32_t unique, const mode_t mode = VARIKEY_BOARD_MODE);
+        void detach();
+        bool is_attached() const { return layout != nullptr; }
+
+        void post_text(const int line, const int column, const int font_size, const char *text);
+        void post_icon(const int icon);
+        void post_backlight_mode(const int mode);
+        void post_backlight_color(const uint8_t r, const uint8_t g, const uint8_t b);
+
+        uint32_t get_sequence() const;
+        bool snapshot(state &) const;
+
+        static void remove(const uint32_t unique);
+
+    private:
+        struct shared
+        {
+            std::atomic<uint32_t> sequence;
+            uint32_t magic;
+            state data;
+        };
+
+        state &write_lock();
+        void write_unlock();
+
+        shared *layout{nullptr};
+    };
+
+    /**
+     * \brief single thread flushing changed board fields to the gadget
+     */
+    class board_driver
+    {
+    public:
+        board_driver(board &, gadget::usb &);
+        virtual ~board_driver();
+
+        void start(const uint32_t interval);
+        void stop();
+        bool is_running() const { return running; }
+
+        size_t flush();
+
+        uint64_t get_flushes() const { return flushes; }
+        uint64_t get_fields() const { return fields; }
+
+    private:
+        void run(const uint32_t interval);
+
+        board &source;
+        gadget::usb &gadget;
+
+        std::thread worker;
+        std::atomic<bool> running{false};
+
+        uint32_t sequence{0};
+        uint32_t generation[board::FIELD_COUNT]{};
+        uint8_t font_size{0xff};
+        bool pending{false}; /* last flush left fields unsent */
+
+        uint64_t flushes{0};
+        uint64_t fields{0};
+    };
+}
+
+#endif /* __VARIKEY_BOARD_HPP__ */
@@ -0,0 +1,85 @@
+/**
+ * \file varikey_capability.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_CAPABILITY_HPP__
+#define __VARIKEY_CAPABILITY_HPP__
+
+#include <cstdint>
+
+#include "varikey_command.hpp"
+#include "varikey_gadget.hpp"
+
+namespace varikey
+{
+    namespace gadget
+    {
+        /**
+         * \brief output capabilities of a gadget type
+         * @{
+         */
+        enum capability : uint8_t
+        {
+            CAPABILITY_NONE = 0x00,
+            CAPABILITY_BACKLIGHT = 0x01,
+            CAPABILITY_DISPLAY = 0x02,
+            CAPABILITY_ALL = 0x03,
+        };
+        /** }@ */
+
+        /**
+         * \brief capabilities of a gadget type
+         *
+         * an unknown or reserved type gets all capabilities, nothing is
+         * suppressed on a device that could not be identified
+         */
+        constexpr uint8_t capabilities_of(const type _type)
+        {
+            switch (_type)
+            {
+            case type::DEFAULT:
+                return CAPABILITY_NONE;
+            case type::BACKLIGHT:
+                return CAPABILITY_BACKLIGHT;
+            case type::DISPLAY:
+                return CAPABILITY_BACKLIGHT | CAPABILITY_DISPLAY;
+            case type::ILLEGAL:
+            case type::EXTENDED:
+                break;
+            }
+            return CAPABILITY_ALL;
+        }
+
+        /**
+         * \brief capabilities needed by an output command
+         */
+        constexpr uint8_t capabilities_required(const uint8_t _command)
+        {
+            switch (static_cast<command_id>(_command))
+            {
+            case command_id::POSITION:
+            case command_id::ICON:
+            case command_id::FONT_SIZE:
+            case command_id::TEXT:
+                return CAPABILITY_DISPLAY;
+            case command_id::BACKLIGHT:
+                return CAPABILITY_BACKLIGHT;
+            case command_id::RESET:
+            case command_id::COMPOUND: /* subcommands are checked before packing */
+                break;
+            }
+            return CAPABILITY_NONE;
+        }
+
+        constexpr bool supports(const uint8_t _capabilities, const uint8_t _command)
+        {
+            return (capabilities_required(_command) & _capabilities) == capabilities_required(_command);
+        }
+    }
+}
+
+#endif /* __VARIKEY_CAPABILITY_HPP__ */
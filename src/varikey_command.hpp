@@ -9,12 +9,27 @@
 #ifndef __VARIKEY_COMMAND_HPP__
 #define __VARIKEY_COMMAND_HPP__
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#define VARIKEY_TEXT_SIZE 40
+
+/**
+ * \brief compound output reports
+ * @{
+ */
+#define VARIKEY_COMPOUND_VERSION 0x0200 /* first firmware decoding compound reports */
+#define VARIKEY_COMPOUND_LIMIT (VARIKEY_TEXT_SIZE / 2) /* subcommands per report */
+/** }@ */
 
 namespace varikey
 {
     enum class report_id : unsigned char
     {
+        KEYBOARD = 1, /* input: modifier, reserved, 6 key codes */
+        CONSUMER = 3, /* input: 16 bit usage, encoder as volume up/down */
         CUSTOM = 6,
         SERIAL = 7,
         GADGET = 8,
@@ -30,7 +45,8 @@ namespace varikey
         ICON = 3,
         FONT_SIZE = 4,
         TEXT = 5,
-        BACKLIGHT = 6
+        BACKLIGHT = 6,
+        COMPOUND = 7, /* subcommands as command, length, arguments */
     };
 
     struct __attribute__((__packed__)) command
@@ -45,10 +61,145 @@ namespace varikey
                 uint8_t column;
             } position;
             uint8_t byte_value;
-            uint8_t text[40];
+            uint8_t text[VARIKEY_TEXT_SIZE];
         } payload;
     };
 
+    /**
+     * \brief encode custom output reports
+     * @{
+     */
+    inline command make_command(const command_id _id)
+    {
+        command cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.report = static_cast<uint8_t>(report_id::CUSTOM);
+        cmd.command = static_cast<uint8_t>(_id);
+        return cmd;
+    }
+
+    inline command encode_reset()
+    {
+        return make_command(command_id::RESET);
+    }
+
+    inline command encode_position(const int _line, const int _column)
+    {
+        command cmd = make_command(command_id::POSITION);
+        cmd.payload.position.line = _line;
+        cmd.payload.position.column = _column;
+        return cmd;
+    }
+
+    inline command encode_icon(const int _icon)
+    {
+        command cmd = make_command(command_id::ICON);
+        cmd.payload.byte_value = _icon;
+        return cmd;
+    }
+
+    inline command encode_font_size(const int _font_size)
+    {
+        command cmd = make_command(command_id::FONT_SIZE);
+        cmd.payload.byte_value = _font_size;
+        return cmd;
+    }
+
+    inline command encode_text(const std::string_view _text)
+    {
+        command cmd = make_command(command_id::TEXT);
+        memcpy(cmd.payload.text, _text.data(), std::min(_text.length(), sizeof(cmd.payload.text)));
+        return cmd;
+    }
+
+    inline command encode_backlight_mode(const int _mode)
+    {
+        command cmd = make_command(command_id::BACKLIGHT);
+        cmd.payload.byte_value = _mode;
+        return cmd;
+    }
+
+    inline command encode_backlight_color(const uint8_t _r, const uint8_t _g, const uint8_t _b)
+    {
+        command cmd = make_command(command_id::BACKLIGHT);
+        cmd.payload.text[0] = 0xaa;
+        cmd.payload.text[1] = _r;
+        cmd.payload.text[2] = _g;
+        cmd.payload.text[3] = _b;
+        return cmd;
+    }
+    /** }@ */
+
+    /**
+     * \brief used argument bytes of a command, a text ends at its first zero
+     */
+    inline size_t argument_length(const command &_cmd)
+    {
+        switch (static_cast<command_id>(_cmd.command))
+        {
+        case command_id::RESET:
+            return 0;
+        case command_id::POSITION:
+            return sizeof(_cmd.payload.position);
+        case command_id::ICON:
+        case command_id::FONT_SIZE:
+            return sizeof(_cmd.payload.byte_value);
+        case command_id::BACKLIGHT:
+            return (_cmd.payload.text[0] == 0xaa) ? 4 : sizeof(_cmd.payload.byte_value);
+        case command_id::TEXT:
+            return strnlen(reinterpret_cast<const char *>(_cmd.payload.text), VARIKEY_TEXT_SIZE);
+        case command_id::COMPOUND:
+            break;
+        }
+        return VARIKEY_TEXT_SIZE;
+    }
+
+    /**
+     * \brief pack and unpack compound reports
+     *
+     * A compound report carries subcommands back to back, each as command
+     * id, argument length and arguments; a zero command id ends the list.
+     * Compound reports do not nest.
+     * @{
+     */
+    inline bool append_compound(command &_compound, size_t &_used, const command &_cmd)
+    {
+        const size_t length = argument_length(_cmd);
+        if (_cmd.command == static_cast<uint8_t>(command_id::COMPOUND) ||
+            _used + 2 + length > VARIKEY_TEXT_SIZE)
+        {
+            return false;
+        }
+
+        _compound.payload.text[_used] = _cmd.command;
+        _compound.payload.text[_used + 1] = static_cast<uint8_t>(length);
+        memcpy(_compound.payload.text + _used + 2, _cmd.payload.text, length);
+        _used += 2 + length;
+        return true;
+    }
+
+    inline size_t decode_compound(const command &_compound, command *_commands, const size_t _limit)
+    {
+        size_t count = 0;
+        size_t used = 0;
+        while (count < _limit && used + 2 <= VARIKEY_TEXT_SIZE && _compound.payload.text[used] != 0)
+        {
+            const uint8_t id = _compound.payload.text[used];
+            const size_t length = _compound.payload.text[used + 1];
+            if (id == static_cast<uint8_t>(command_id::COMPOUND) || used + 2 + length > VARIKEY_TEXT_SIZE)
+            {
+                break;
+            }
+
+            _commands[count] = make_command(static_cast<command_id>(id));
+            memcpy(_commands[count].payload.text, _compound.payload.text + used + 2, length);
+            used += 2 + length;
+            ++count;
+        }
+        return count;
+    }
+    /** }@ */
+
     struct __attribute__((__packed__)) feature
     {
         uint8_t report;
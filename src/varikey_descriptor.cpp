@@ -0,0 +1,171 @@
+/**
+ * \file varikey_descriptor.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "varikey_descriptor.hpp"
+
+/**
+ * \brief HID short item tags, HID 1.11 chapter 6.2.2
+ * @{
+ */
+#define ITEM_TYPE_MAIN 0
+#define ITEM_TYPE_GLOBAL 1
+#define ITEM_TAG_INPUT 0x8
+#define ITEM_TAG_OUTPUT 0x9
+#define ITEM_TAG_FEATURE 0xb
+#define ITEM_TAG_REPORT_SIZE 0x7
+#define ITEM_TAG_REPORT_ID 0x8
+#define ITEM_TAG_REPORT_COUNT 0x9
+#define ITEM_TAG_PUSH 0xa
+#define ITEM_TAG_POP 0xb
+#define ITEM_LONG 0xfe
+#define ITEM_STACK_DEPTH 8
+/** }@ */
+
+namespace varikey
+{
+    report_descriptor::report_descriptor()
+    {
+        clear();
+    }
+
+    void report_descriptor::clear()
+    {
+        memset(bits, 0, sizeof(bits));
+        fields.clear();
+        valid = false;
+        numbered = false;
+    }
+
+    /**
+     * \brief parse a raw report descriptor
+     *
+     * @param data descriptor bytes
+     * @param size descriptor length
+     * @return true if the descriptor was well formed
+     */
+    bool report_descriptor::parse(const uint8_t *_data, const size_t _size)
+    {
+        clear();
+
+        struct global
+        {
+            uint32_t size;
+            uint32_t count;
+            uint8_t id;
+        } state = {0, 0, 0}, stack[ITEM_STACK_DEPTH];
+        size_t depth = 0;
+
+        size_t position = 0;
+        while (position < _size)
+        {
+            const uint8_t prefix = _data[position++];
+
+            if (prefix == ITEM_LONG)
+            {
+                if (position + 2 > _size)
+                {
+                    return false;
+                }
+                position += 2 + _data[position];
+                continue;
+            }
+
+            const size_t length = ((prefix & 0x3) == 3) ? 4 : (prefix & 0x3);
+            if (position + length > _size)
+            {
+                return false;
+            }
+
+            uint32_t value = 0;
+            for (size_t i = 0; i < length; ++i)
+            {
+                value |= static_cast<uint32_t>(_data[position + i]) << (8 * i);
+            }
+            position += length;
+
+            const uint8_t kind = (prefix >> 2) & 0x3;
+            const uint8_t tag = prefix >> 4;
+
+            if (kind == ITEM_TYPE_GLOBAL)
+            {
+                switch (tag)
+                {
+                case ITEM_TAG_REPORT_SIZE:
+                    state.size = value;
+                    break;
+                case ITEM_TAG_REPORT_COUNT:
+                    state.count = value;
+                    break;
+                case ITEM_TAG_REPORT_ID:
+                    state.id = static_cast<uint8_t>(value);
+                    numbered = true;
+                    break;
+                case ITEM_TAG_PUSH:
+                    if (depth >= ITEM_STACK_DEPTH)
+                    {
+                        return false;
+                    }
+                    stack[depth++] = state;
+                    break;
+                case ITEM_TAG_POP:
+                    if (depth == 0)
+                    {
+                        return false;
+                    }
+                    state = stack[--depth];
+                    break;
+                default:
+                    break;
+                }
+            }
+            else if (kind == ITEM_TYPE_MAIN &&
+                     (tag == ITEM_TAG_INPUT || tag == ITEM_TAG_OUTPUT || tag == ITEM_TAG_FEATURE))
+            {
+                const type report = (tag == ITEM_TAG_INPUT)    ? type::INPUT
+                                    : (tag == ITEM_TAG_OUTPUT) ? type::OUTPUT
+                                                               : type::FEATURE;
+                uint16_t &total = bits[static_cast<int>(report)][state.id];
+
+                fields.push_back({report, state.id, total,
+                                  static_cast<uint8_t>(state.size), static_cast<uint8_t>(state.count),
+                                  static_cast<uint16_t>(value)});
+                total += state.size * state.count;
+            }
+        }
+
+        valid = true;
+        return valid;
+    }
+
+    /**
+     * \brief report payload length in bytes without the report id
+     */
+    size_t report_descriptor::get_length(const type _type, const uint8_t _id) const
+    {
+        return (bits[static_cast<int>(_type)][_id] + 7) / 8;
+    }
+
+    /**
+     * \brief bytes to transfer for a report including the report id
+     *
+     * @param fallback length used for unknown reports
+     * @return size_t transfer length, never above the fallback buffer
+     */
+    size_t report_descriptor::get_transfer_length(const type _type, const uint8_t _id, const size_t _fallback) const
+    {
+        const size_t length = get_length(_type, _id);
+        if (!valid || length == 0)
+        {
+            return _fallback;
+        }
+        return std::min(length + (numbered ? 1 : 0), _fallback);
+    }
+}
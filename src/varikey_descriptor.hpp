@@ -0,0 +1,69 @@
+/**
+ * \file varikey_descriptor.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_DESCRIPTOR_HPP__
+#define __VARIKEY_DESCRIPTOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define VARIKEY_REPORT_IDS 256
+
+namespace varikey
+{
+    /**
+     * \brief report sizes and field layout from a HID report descriptor
+     *
+     * Only the items that define the report layout are evaluated: report
+     * size, count and id, push/pop of the global state and the input,
+     * output and feature main items.
+     */
+    class report_descriptor
+    {
+    public:
+        enum class type : uint8_t
+        {
+            INPUT = 0,
+            OUTPUT,
+            FEATURE,
+            COUNT,
+        };
+
+        struct field
+        {
+            type kind;
+            uint8_t id;
+            uint16_t offset; /* bit offset behind the report id */
+            uint8_t size;    /* bits per element */
+            uint8_t count;   /* number of elements */
+            uint16_t flags;  /* main item data, bit 0 constant */
+        };
+
+        report_descriptor();
+        virtual ~report_descriptor() {}
+
+        bool parse(const uint8_t *data, const size_t size);
+        void clear();
+
+        bool is_valid() const { return valid; }
+        bool is_numbered() const { return numbered; }
+
+        size_t get_length(const type, const uint8_t id) const;
+        size_t get_transfer_length(const type, const uint8_t id, const size_t fallback) const;
+        const std::vector<field> &get_fields() const { return fields; }
+
+    private:
+        uint16_t bits[static_cast<int>(type::COUNT)][VARIKEY_REPORT_IDS];
+        std::vector<field> fields;
+        bool valid{false};
+        bool numbered{false};
+    };
+}
+
+#endif /* __VARIKEY_DESCRIPTOR_HPP__ */
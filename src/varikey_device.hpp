@@ -15,6 +15,7 @@
 
 #define VARIKEY_SERIAL_NUMBER_SIZE 12
 #define VARIKEY_NAME_SIZE 32
+#define VARIKEY_PATH_SIZE 64
 
 namespace varikey
 {
@@ -0,0 +1,76 @@
+/**
+ * \file varikey_encoder.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+
+#include "varikey_encoder.hpp"
+
+/**
+ * \brief default acceleration, off until configured
+ * @{
+ */
+#define ENCODER_THRESHOLD 40000000ULL /* 40 ms */
+#define ENCODER_MAXIMUM 8
+/** }@ */
+
+namespace varikey
+{
+    encoder::encoder()
+    {
+        configure({false, ENCODER_THRESHOLD, ENCODER_MAXIMUM});
+    }
+
+    void encoder::configure(const acceleration &_setup)
+    {
+        setup = _setup;
+        setup.maximum = std::max(setup.maximum, 1);
+    }
+
+    /**
+     * \brief merge one encoder step, called from the input path only
+     */
+    void encoder::feed(const input::event &_event)
+    {
+        if (_event.kind != input::type::ENCODER || _event.value == 0)
+        {
+            return;
+        }
+
+        int32_t factor = 1;
+        if (setup.enabled && previous != 0 && _event.timestamp > previous)
+        {
+            const uint64_t interval = _event.timestamp - previous;
+            if (interval < setup.threshold)
+            {
+                factor = static_cast<int32_t>(std::min<uint64_t>(setup.threshold / interval, setup.maximum));
+            }
+        }
+        previous = _event.timestamp;
+
+        /* two's complement addition in the upper half keeps the sign */
+        const int32_t step = (_event.value > 0) ? factor : -factor;
+        const uint64_t increment = (static_cast<uint64_t>(static_cast<uint32_t>(step)) << 32) + 1;
+        pending.fetch_add(increment, std::memory_order_release);
+        latest.store(_event.timestamp, std::memory_order_release);
+    }
+
+    /**
+     * \brief take the net delta since the previous read
+     *
+     * @param value merged delta
+     * @return true if at least one step was merged
+     */
+    bool encoder::read(delta &_value)
+    {
+        const uint64_t taken = pending.exchange(0, std::memory_order_acquire);
+        _value.value = static_cast<int32_t>(static_cast<uint32_t>(taken >> 32));
+        _value.steps = static_cast<uint32_t>(taken & 0xffffffff);
+        _value.timestamp = latest.load(std::memory_order_acquire);
+        return _value.steps > 0;
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * \file varikey_encoder.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_ENCODER_HPP__
+#define __VARIKEY_ENCODER_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+#include "varikey_input.hpp"
+
+namespace varikey
+{
+    /**
+     * \brief rotary encoder step aggregation for one consumer
+     *
+     * The input path feeds single steps, the consumer reads the net delta
+     * of all steps since its previous read. Feeding and reading are lock
+     * free, a slow consumer never delays the input path and never lags
+     * behind the knob. Optional acceleration scales a step by the spin
+     * velocity: a step following the previous one within the threshold
+     * counts threshold/interval times, up to the maximum factor.
+     */
+    class encoder
+    {
+    public:
+        struct acceleration
+        {
+            bool enabled;
+            uint64_t threshold; /* ns between two steps below which acceleration starts */
+            int32_t maximum;    /* largest step factor */
+        };
+
+        struct delta
+        {
+            int32_t value;      /* net accelerated delta */
+            uint32_t steps;     /* number of merged steps */
+            uint64_t timestamp; /* time of the latest merged step */
+        };
+
+        encoder();
+        virtual ~encoder() {}
+
+        void configure(const acceleration &);
+        const acceleration &get_acceleration() const { return setup; }
+
+        void feed(const input::event &);
+        bool read(delta &);
+
+    private:
+        acceleration setup;
+
+        /* net delta in the upper, step count in the lower half */
+        std::atomic<uint64_t> pending{0};
+        std::atomic<uint64_t> latest{0};
+        uint64_t previous{0};
+    };
+}
+
+#endif /* __VARIKEY_ENCODER_HPP__ */
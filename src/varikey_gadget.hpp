@@ -21,6 +21,19 @@ namespace varikey
             DISPLAY = 0xa3,   /* 10 buttons, rotary encoder, backlight, 128x32 display */
             EXTENDED = 0xa9,  /* reserved */
         };
+
+        /**
+         * \brief result of a gadget operation
+         */
+        enum class status : unsigned char
+        {
+            SUCCESS = 0,
+            FAILURE,     /* device error, the device is closed */
+            TIMEOUT,     /* deadline passed, the device stays open */
+            BUSY,        /* an earlier timed out call still blocks the device */
+            CLOSED,      /* device not open */
+            UNSUPPORTED, /* gadget type lacks the capability, nothing sent */
+        };
     }
 };
 
@@ -0,0 +1,87 @@
+/**
+ * \file varikey_gadget_handle.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_GADGET_HANDLE_HPP__
+#define __VARIKEY_GADGET_HANDLE_HPP__
+
+#include "varikey_capability.hpp"
+#include "varikey_gadget_usb.hpp"
+
+namespace varikey
+{
+    namespace gadget
+    {
+        /**
+         * \brief gadget access typed by its gadget type
+         *
+         * Operations the type cannot perform do not compile, e.g. print_text
+         * on a handle<type::BACKLIGHT>. is_valid checks that the device
+         * really is of the expected type.
+         */
+        template <type T>
+        class handle
+        {
+        public:
+            static constexpr uint8_t capabilities = capabilities_of(T);
+
+            explicit handle(usb &_device) : device(_device) {}
+
+            bool is_valid() { return device.is_open() && device.get_gadget() == T; }
+            usb &get() { return device; }
+
+            status reset_device(const uint64_t deadline = 0) { return device.reset_device(deadline); }
+
+            status set_position(const int line, const int column, const uint64_t deadline = 0)
+            {
+                static_assert(capabilities & CAPABILITY_DISPLAY, "gadget type has no display");
+                return device.set_position(line, column, deadline);
+            }
+
+            status draw_icon(const int icon, const uint64_t deadline = 0)
+            {
+                static_assert(capabilities & CAPABILITY_DISPLAY, "gadget type has no display");
+                return device.draw_icon(icon, deadline);
+            }
+
+            status set_font_size(const int font_size, const uint64_t deadline = 0)
+            {
+                static_assert(capabilities & CAPABILITY_DISPLAY, "gadget type has no display");
+                return device.set_font_size(font_size, deadline);
+            }
+
+            status print_text(const std::string_view text, const uint64_t deadline = 0)
+            {
+                static_assert(capabilities & CAPABILITY_DISPLAY, "gadget type has no display");
+                return device.print_text(text, deadline);
+            }
+
+            status set_backlight_mode(const int mode, const uint64_t deadline = 0)
+            {
+                static_assert(capabilities & CAPABILITY_BACKLIGHT, "gadget type has no backlight");
+                return device.set_backlight_mode(mode, deadline);
+            }
+
+            status set_backlight_color(const uint8_t r, const uint8_t g, const uint8_t b, const uint64_t deadline = 0)
+            {
+                static_assert(capabilities & CAPABILITY_BACKLIGHT, "gadget type has no backlight");
+                return device.set_backlight_color(r, g, b, deadline);
+            }
+
+            status get_temperature(float &value, const uint64_t deadline = 0) { return device.get_temperature(value, deadline); }
+
+        private:
+            usb &device;
+        };
+
+        using default_handle = handle<type::DEFAULT>;
+        using backlight_handle = handle<type::BACKLIGHT>;
+        using display_handle = handle<type::DISPLAY>;
+    }
+}
+
+#endif /* __VARIKEY_GADGET_HANDLE_HPP__ */
@@ -6,6 +6,8 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -14,9 +16,12 @@
 #include <linux/hiddev.h>
 #include <linux/hidraw.h>
 #include <linux/input.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include "varikey_gadget_usb.hpp"
+#include "varikey_log.hpp"
+#include "varikey_trace.hpp"
 
 /**
  * \brief USB device identifiers
@@ -36,7 +41,10 @@ namespace varikey
         /**
          * \brief Construct a new wizard usb entity::wizard usb entity object
          */
-        usb::usb() {}
+        usb::usb()
+        {
+            std::fill(input_handle, input_handle + VARIKEY_INPUT_LIMIT, -1);
+        }
 
         /**
          * \brief Destroy the wizard usb entity::wizard usb entity object
@@ -49,51 +57,140 @@ namespace varikey
         /**
          * \brief open usb device defined by path
          *
+         * the handle is non-blocking, open and identification ioctls are
+         * bounded by the deadline
+         *
          * @param _device_path
+         * @param _deadline absolute CLOCK_MONOTONIC deadline in ns, 0 for the default timeout
+         * @return status
          */
-        void usb::usb_open(const char *_device_path)
+        status usb::usb_open(const char *_device_path, const uint64_t _deadline)
         {
+            VARIKEY_TRACE("open", device.unique);
+            if (strncmp(device_path, _device_path, sizeof(device_path)) != 0)
+            {
+                strncpy(device_path, _device_path, sizeof(device_path) - 1);
+                identity_loaded = 0;
+                identity_attempted = 0;
+                report_layout.clear();
+            }
 
             if (device_handle != INVALID_HANDLE_VALUE)
             {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
+                drop_handle();
             }
 
-            device_handle = open(_device_path, O_RDWR);
-            if (device_handle < 0)
+            /* a new handle starts over at the initial report rate */
+            pending_mask = 0;
+            rate.reset();
+            const uint64_t deadline = resolve(_deadline);
+
+            int handle = -1;
+            if (deadline == 0)
             {
-                device_handle = INVALID_HANDLE_VALUE;
-                return;
+                handle = link->open(_device_path, O_RDWR | O_NONBLOCK);
             }
+            else
+            {
+                if (!worker)
+                {
+                    worker.reset(new io_worker(link));
+                }
+
+                int error = 0;
+                switch (worker->call_open(_device_path, O_RDWR | O_NONBLOCK, deadline, handle, error))
+                {
+                case io_worker::outcome::DONE:
+                    errno = error;
+                    break;
+                case io_worker::outcome::TIMEOUT:
+                    ++timeouts;
+                    log::post(log::severity::WARNING, log::event::OPEN_TIMEOUT, device.unique);
+                    return status::TIMEOUT;
+                case io_worker::outcome::BUSY:
+                    return status::BUSY;
+                }
+            }
+
+            if (handle < 0)
+            {
+                return status::FAILURE;
+            }
+            device_handle = handle;
 
             device_valid = true;
 
             struct hidraw_devinfo dinfo;
-            if (ioctl(device_handle, HIDIOCGRAWINFO, (void *)&dinfo) < 0)
+            status result = control(HIDIOCGRAWINFO, (void *)&dinfo, sizeof(dinfo), deadline);
+            if (result != status::SUCCESS)
             {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-                return;
+                if (result == status::TIMEOUT)
+                {
+                    log::post(log::severity::WARNING, log::event::OPEN_TIMEOUT, device.unique);
+                }
+                drop_handle();
+                return result;
             }
 
             if (!(((uint16_t)dinfo.vendor == VARIKEY_VENDOR_IDENTIFIER) &&
                   ((uint16_t)dinfo.product == VARIKEY_PRODUCT_IDENTIFIER)))
             {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-                return;
+                drop_handle();
+                return status::FAILURE;
             }
 
             device.bustype = dinfo.bustype;
             device.product = dinfo.product;
             device.vendor = dinfo.vendor;
 
-            if (ioctl(device_handle, HIDIOCGRAWNAME(VARIKEY_NAME_SIZE), (void *)&device.name) < 0)
+            result = control(HIDIOCGRAWNAME(VARIKEY_NAME_SIZE), (void *)&device.name, sizeof(device.name), deadline);
+            if (result == status::FAILURE)
             {
-                perror("error sending report");
-                fprintf(stderr, "error sending report: %d %s\n", errno, strerror(errno));
+                log::post(log::severity::WARNING, log::event::NAME_FAILED, device.unique, 0, errno);
             }
+            else if (result != status::SUCCESS)
+            {
+                if (result == status::TIMEOUT)
+                {
+                    log::post(log::severity::WARNING, log::event::OPEN_TIMEOUT, device.unique);
+                }
+                drop_handle();
+                return result;
+            }
+
+            if (!report_layout.is_valid())
+            {
+                usb_get_descriptor();
+            }
+            open_inputs();
+            return status::SUCCESS;
+        }
+
+        /**
+         * \brief read and parse the report descriptor
+         *
+         * reports are sent with the lengths declared there, the packed
+         * command structures are the fallback for unknown reports
+         */
+        void usb::usb_get_descriptor()
+        {
+            VARIKEY_TRACE("descriptor", device.unique);
+            int size = 0;
+            if (link->control(device_handle, HIDIOCGRDESCSIZE, &size) < 0 || size <= 0)
+            {
+                return;
+            }
+
+            /* served from the kernel copy, the device is not involved */
+            struct hidraw_report_descriptor descriptor;
+            descriptor.size = std::min<uint32_t>(size, HID_MAX_DESCRIPTOR_SIZE);
+            if (link->control(device_handle, HIDIOCGRDESC, &descriptor) < 0)
+            {
+                log::post(log::severity::WARNING, log::event::DESCRIPTOR_FAILED, device.unique, 0, errno);
+                return;
+            }
+
+            report_layout.parse(descriptor.value, descriptor.size);
         }
 
         /**
@@ -101,42 +198,221 @@ namespace varikey
          */
         void usb::usb_close()
         {
+            VARIKEY_TRACE("close", device.unique);
             if (device_handle != INVALID_HANDLE_VALUE)
             {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
+                flush_pending(0);
+                drop_handle();
             }
         }
 
+        /**
+         * \brief release the handle
+         *
+         * a handle still used by a timed out call is closed by the worker
+         * once that call returns
+         */
+        void usb::drop_handle()
+        {
+            if (device_handle == INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+
+            if (worker)
+            {
+                worker->close_later(device_handle);
+            }
+            else
+            {
+                link->close(device_handle);
+            }
+            device_handle = INVALID_HANDLE_VALUE;
+            close_inputs();
+        }
+
+        /**
+         * \brief input interfaces read beside the control interface
+         *
+         * takes effect with the next open
+         *
+         * @param paths hidraw nodes sharing the usb port of the device
+         * @param count number of paths, at most VARIKEY_INPUT_LIMIT are used
+         */
+        void usb::set_inputs(const char (*_paths)[VARIKEY_PATH_SIZE], const size_t _count)
+        {
+            input_count = std::min<size_t>(_count, VARIKEY_INPUT_LIMIT);
+            for (size_t i = 0; i < input_count; ++i)
+            {
+                memcpy(input_path[i], _paths[i], VARIKEY_PATH_SIZE);
+                input_path[i][VARIKEY_PATH_SIZE - 1] = '\0';
+            }
+        }
+
+        /**
+         * \brief open the input interfaces, one that fails is left out
+         */
+        void usb::open_inputs()
+        {
+            for (size_t i = 0; i < input_count; ++i)
+            {
+                if (input_handle[i] < 0)
+                {
+                    input_handle[i] = link->open(input_path[i], O_RDONLY | O_NONBLOCK);
+                }
+            }
+        }
+
+        void usb::close_inputs()
+        {
+            for (size_t i = 0; i < VARIKEY_INPUT_LIMIT; ++i)
+            {
+                if (input_handle[i] >= 0)
+                {
+                    link->close(input_handle[i]);
+                    input_handle[i] = -1;
+                }
+            }
+        }
+
+        /**
+         * \brief replace the device access, hidraw by default
+         *
+         * an open device is closed, the transport applies from the next open
+         */
+        void usb::set_transport(std::shared_ptr<transport> _link)
+        {
+            usb_close();
+            worker.reset();
+            link = _link;
+        }
+
         /**
          * \brief initialize device
+         *
+         * only the unique identifier is needed to find a device, all other
+         * identity fields are read on first access
          */
         void usb::usb_init()
         {
             if (device_handle != INVALID_HANDLE_VALUE)
             {
+                identity_loaded = 0;
+                identity_attempted = IDENTITY_UNIQUE;
+                usb_get_unique();
+            }
+        }
+
+        /**
+         * \brief get varikey gadget serial number, read on demand
+         */
+        const uint8_t *usb::get_serial()
+        {
+            load_identity(IDENTITY_SERIAL);
+            return device.serial;
+        }
+
+        /**
+         * \brief get varikey gadget type, read on demand
+         */
+        gadget::type usb::get_gadget()
+        {
+            load_identity(IDENTITY_GADGET);
+            return device.gadget;
+        }
+
+        /**
+         * \brief output capabilities of the gadget type, read on demand
+         */
+        uint8_t usb::get_capabilities()
+        {
+            load_identity(IDENTITY_GADGET);
+            return capabilities_of(device.gadget);
+        }
+
+        /**
+         * \brief get varikey gadget hardware revision, read on demand
+         */
+        uint32_t usb::get_hardware()
+        {
+            load_identity(IDENTITY_HARDWARE);
+            return device.hardware;
+        }
+
+        /**
+         * \brief get varikey gadget firmware revision, read on demand
+         */
+        uint32_t usb::get_version()
+        {
+            load_identity(IDENTITY_VERSION);
+            return device.version;
+        }
+
+        /**
+         * \brief read a missing identity field
+         *
+         * a closed device is opened for the read and closed afterwards; each
+         * field is read once, a failed read keeps the default until the
+         * device path changes or usb_init reads the identity again
+         *
+         * @param field identity field
+         */
+        void usb::load_identity(const identity field)
+        {
+            if (((identity_loaded | identity_attempted) & field) || !device_valid)
+            {
+                return;
+            }
+            VARIKEY_TRACE("identity", device.unique);
+
+            const bool temporary = (device_handle == INVALID_HANDLE_VALUE);
+            if (temporary)
+            {
+                if (device_path[0] == '\0')
+                {
+                    return;
+                }
+                usb_open(device_path);
+                if (device_handle == INVALID_HANDLE_VALUE)
+                {
+                    /* not attempted, the next access opens again */
+                    return;
+                }
+            }
+
+            identity_attempted |= field;
+            switch (field)
+            {
+            case IDENTITY_SERIAL:
                 usb_get_serial();
+                break;
+            case IDENTITY_UNIQUE:
                 usb_get_unique();
+                break;
+            case IDENTITY_GADGET:
                 usb_get_gadget();
+                break;
+            case IDENTITY_HARDWARE:
                 usb_get_hardware();
+                break;
+            case IDENTITY_VERSION:
                 usb_get_version();
+                break;
+            }
+
+            if (temporary)
+            {
+                usb_close();
             }
         }
 
         /**
          * \brief reset and close an open device
          */
-        void usb::reset_device()
+        status usb::reset_device(const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::RESET);
-
-            if (send_report(device_handle, cmd) < 0)
-            {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-            }
+            command cmd = encode_reset();
+            return send_command(cmd, _deadline);
         }
 
         /**
@@ -145,19 +421,10 @@ namespace varikey
          * @param line
          * @param column
          */
-        void usb::set_position(const int line, const int column)
+        status usb::set_position(const int line, const int column, const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::POSITION);
-            cmd.payload.position.line = line;
-            cmd.payload.position.column = column;
-
-            if (send_report(device_handle, cmd) < 0)
-            {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-            }
+            command cmd = encode_position(line, column);
+            return send_command(cmd, _deadline);
         }
 
         /**
@@ -167,18 +434,10 @@ namespace varikey
          *
          * @param icon
          */
-        void usb::draw_icon(const int icon)
+        status usb::draw_icon(const int icon, const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::ICON);
-            cmd.payload.byte_value = icon;
-
-            if (send_report(device_handle, cmd) < 0)
-            {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-            }
+            command cmd = encode_icon(icon);
+            return send_command(cmd, _deadline);
         }
 
         /**
@@ -188,18 +447,10 @@ namespace varikey
          *
          * @param font_size
          */
-        void usb::set_font_size(const int font_size)
+        status usb::set_font_size(const int font_size, const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::FONT_SIZE);
-            cmd.payload.byte_value = font_size;
-
-            if (send_report(device_handle, cmd) < 0)
-            {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-            }
+            command cmd = encode_font_size(font_size);
+            return send_command(cmd, _deadline);
         }
 
         /**
@@ -209,19 +460,10 @@ namespace varikey
          *
          * @param text
          */
-        void usb::print_text(const char *text)
+        status usb::print_text(const std::string_view text, const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::TEXT);
-            memset(cmd.payload.text, 0, sizeof(cmd.payload.text));
-            memcpy((char *)cmd.payload.text, text, strlen(text));
-
-            if (send_report(device_handle, cmd) < 0)
-            {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-            }
+            command cmd = encode_text(text);
+            return send_command(cmd, _deadline);
         }
 
         /**
@@ -231,18 +473,10 @@ namespace varikey
          *
          * @param mode
          */
-        void usb::set_backlight_mode(const int mode)
+        status usb::set_backlight_mode(const int mode, const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::BACKLIGHT);
-            cmd.payload.byte_value = mode;
-
-            if (send_report(device_handle, cmd) < 0)
-            {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
-            }
+            command cmd = encode_backlight_mode(mode);
+            return send_command(cmd, _deadline);
         }
 
         /**
@@ -252,42 +486,242 @@ namespace varikey
          * \param g green channel
          * \param b blue channel
          */
-        void usb::set_backlight_color(const uint8_t r, const uint8_t g, const uint8_t b)
+        status usb::set_backlight_color(const uint8_t r, const uint8_t g, const uint8_t b, const uint64_t _deadline)
         {
-            command cmd;
-            cmd.report = static_cast<unsigned char>(varikey::report_id::CUSTOM);
-            cmd.command = static_cast<unsigned char>(varikey::command_id::BACKLIGHT);
-            cmd.payload.text[0] = 0xaa;
-            cmd.payload.text[1] = r;
-            cmd.payload.text[2] = g;
-            cmd.payload.text[3] = b;
+            command cmd = encode_backlight_color(r, g, b);
+            return send_command(cmd, _deadline);
+        }
+
+        /**
+         * \brief send a prepared output report
+         *
+         * the device is closed on error, it stays open on a timeout;
+         * a command the gadget type cannot perform is not sent
+         *
+         * @param cmd encoded command
+         * @param _deadline absolute CLOCK_MONOTONIC deadline in ns, 0 for the default timeout
+         * @return status
+         */
+        status usb::send_command(command &cmd, const uint64_t _deadline)
+        {
+            VARIKEY_TRACE("command", device.unique);
+            if (device_handle == INVALID_HANDLE_VALUE)
+            {
+                return status::CLOSED;
+            }
 
-            if (send_report(device_handle, cmd) < 0)
+            if (!supports(cmd))
             {
-                close(device_handle);
-                device_handle = INVALID_HANDLE_VALUE;
+                return status::UNSUPPORTED;
             }
+
+            const status result = send_report(cmd, resolve(_deadline));
+            if (result == status::FAILURE)
+            {
+                drop_handle();
+            }
+            else if (result == status::SUCCESS)
+            {
+                state.apply(cmd);
+            }
+            return result;
+        }
+
+        /**
+         * \brief send a command sequence, packed into compound reports
+         *
+         * firmware without compound support gets one report per command;
+         * commands the gadget type cannot perform are left out, the first
+         * failing report ends the sequence
+         *
+         * @param cmds encoded commands, sent in order
+         * @param count number of commands
+         * @param _deadline absolute CLOCK_MONOTONIC deadline in ns for the whole sequence
+         * @return status
+         */
+        status usb::send_commands(command *cmds, const size_t count, const uint64_t _deadline)
+        {
+            VARIKEY_TRACE("commands", device.unique);
+            if (device_handle == INVALID_HANDLE_VALUE)
+            {
+                return status::CLOSED;
+            }
+
+            const uint64_t deadline = resolve(_deadline);
+            const bool compound = supports_compound();
+
+            status result = status::SUCCESS;
+            size_t i = 0;
+            while (i < count && result == status::SUCCESS)
+            {
+                command report = make_command(command_id::COMPOUND);
+                size_t used = 0;
+                size_t packed[VARIKEY_COMPOUND_LIMIT];
+                size_t packed_count = 0;
+
+                if (compound)
+                {
+                    VARIKEY_TRACE("encode", device.unique);
+                    for (; i < count; ++i)
+                    {
+                        if (!supports(cmds[i]))
+                        {
+                            continue;
+                        }
+                        if (!append_compound(report, used, cmds[i]))
+                        {
+                            break;
+                        }
+                        packed[packed_count++] = i;
+                    }
+                }
+
+                if (packed_count == 0 && i == count)
+                {
+                    /* every remaining command was filtered out */
+                    break;
+                }
+                else if (packed_count == 0)
+                {
+                    /* no compound support or a command filling a report alone */
+                    result = supports(cmds[i]) ? send_command(cmds[i], deadline) : status::SUCCESS;
+                    ++i;
+                }
+                else if (packed_count == 1)
+                {
+                    result = send_command(cmds[packed[0]], deadline);
+                }
+                else
+                {
+                    result = send_command(report, deadline);
+                }
+            }
+            return result;
+        }
+
+        /**
+         * \brief re-apply the last known display and backlight state
+         *
+         * used after a reset or when the gadget reappears after a replug
+         *
+         * @return size_t number of restored commands, 0 on error
+         */
+        size_t usb::restore()
+        {
+            VARIKEY_TRACE("restore", device.unique);
+            command commands[VARIKEY_SNAPSHOT_COMMANDS];
+            const size_t count = state.restore(commands, VARIKEY_SNAPSHOT_COMMANDS);
+
+            return (send_commands(commands, count) == status::SUCCESS) ? count : 0;
         }
 
         /**
          * \brief get gadget processor temperature
          *
-         * @return float
+         * @param value temperature in degree Celsius, set on success only
+         * @param _deadline absolute CLOCK_MONOTONIC deadline in ns, 0 for the default timeout
+         * @return status
          */
-        float usb::get_temperature()
+        status usb::get_temperature(float &value, const uint64_t _deadline)
         {
-            if (device_handle != INVALID_HANDLE_VALUE)
+            VARIKEY_TRACE("temperature", device.unique);
+            if (device_handle == INVALID_HANDLE_VALUE)
             {
-                feature cmd;
-                cmd.report = static_cast<unsigned char>(varikey::report_id::TEMPERATURE);
+                return status::CLOSED;
+            }
 
-                if (send_report(device_handle, cmd) >= 0)
+            feature cmd;
+            cmd.report = static_cast<unsigned char>(varikey::report_id::TEMPERATURE);
+
+            const status result = send_report(cmd, resolve(_deadline));
+            if (result == status::SUCCESS)
+            {
+                value = cmd.payload.long_value / 1000.0;
+            }
+            else if (result == status::FAILURE)
+            {
+                drop_handle();
+            }
+            return result;
+        }
+
+        /**
+         * \brief wait for the next input report
+         *
+         * the control interface and the input interfaces are read alike, a
+         * failed input interface is closed and left out from then on
+         *
+         * @param buffer report buffer, the report id comes first
+         * @param size buffer size
+         * @param timeout poll timeout in ms, -1 waits forever
+         * @return int report length, 0 on timeout, -1 on error
+         */
+        int usb::read_input(uint8_t *buffer, const size_t size, const int timeout)
+        {
+            if (device_handle == INVALID_HANDLE_VALUE)
+            {
+                return -1;
+            }
+
+            struct pollfd input[1 + VARIKEY_INPUT_LIMIT];
+            size_t owner[1 + VARIKEY_INPUT_LIMIT];
+            nfds_t count = 0;
+            input[count++] = {static_cast<int>(device_handle), POLLIN, 0};
+            for (size_t i = 0; i < input_count; ++i)
+            {
+                if (input_handle[i] >= 0)
                 {
-                    return (cmd.payload.long_value / 1000.0);
+                    owner[count] = i;
+                    input[count++] = {input_handle[i], POLLIN, 0};
                 }
             }
 
-            return (float)0xffff;
+            int ready = poll(input, count, timeout);
+            if (ready <= 0)
+            {
+                return (ready < 0 && errno != EINTR) ? -1 : 0;
+            }
+
+            if (input[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                drop_handle();
+                return -1;
+            }
+
+            for (nfds_t i = 0; i < count; ++i)
+            {
+                if (input[i].revents == 0)
+                {
+                    continue;
+                }
+
+                ssize_t length = -1;
+                errno = EIO;
+                if (input[i].revents & POLLIN)
+                {
+                    VARIKEY_TRACE("read", device.unique);
+                    length = link->read(input[i].fd, buffer, size);
+                }
+                if (length >= 0)
+                {
+                    return static_cast<int>(length);
+                }
+                if (errno == EINTR || errno == EAGAIN)
+                {
+                    continue;
+                }
+
+                log::post(log::severity::ERROR, log::event::INPUT_FAILED, device.unique, 0, errno);
+                if (i == 0)
+                {
+                    drop_handle();
+                    return -1;
+                }
+                link->close(input_handle[owner[i]]);
+                input_handle[owner[i]] = -1;
+            }
+
+            return 0;
         }
 
         /**
@@ -300,9 +734,10 @@ namespace varikey
                 feature cmd;
                 cmd.report = static_cast<unsigned char>(varikey::report_id::SERIAL);
 
-                if (send_report(device_handle, cmd) >= 0)
+                if (send_report(cmd, resolve(0)) == status::SUCCESS)
                 {
                     memcpy((char *)device.serial, (char *)&cmd.payload.serial[0], sizeof(device.serial));
+                    identity_loaded |= IDENTITY_SERIAL;
                 }
             }
         }
@@ -317,9 +752,10 @@ namespace varikey
                 feature cmd;
                 cmd.report = static_cast<unsigned char>(varikey::report_id::UNIQUE);
 
-                if (send_report(device_handle, cmd) >= 0)
+                if (send_report(cmd, resolve(0)) == status::SUCCESS)
                 {
                     device.unique = cmd.payload.long_value;
+                    identity_loaded |= IDENTITY_UNIQUE;
                 }
             }
         }
@@ -334,9 +770,10 @@ namespace varikey
                 feature cmd;
                 cmd.report = static_cast<unsigned char>(varikey::report_id::GADGET);
 
-                if (send_report(device_handle, cmd) >= 0)
+                if (send_report(cmd, resolve(0)) == status::SUCCESS)
                 {
                     device.gadget = (gadget::type)cmd.payload.byte_value;
+                    identity_loaded |= IDENTITY_GADGET;
                 }
             }
         }
@@ -350,9 +787,10 @@ namespace varikey
             {
                 feature cmd;
                 cmd.report = static_cast<unsigned char>(varikey::report_id::HARDWARE);
-                if (send_report(device_handle, cmd) >= 0)
+                if (send_report(cmd, resolve(0)) == status::SUCCESS)
                 {
                     device.hardware = cmd.payload.long_value;
+                    identity_loaded |= IDENTITY_HARDWARE;
                 }
             }
         }
@@ -367,47 +805,238 @@ namespace varikey
                 feature cmd;
                 cmd.report = static_cast<unsigned char>(varikey::report_id::VERSION);
 
-                if (send_report(device_handle, cmd) >= 0)
+                if (send_report(cmd, resolve(0)) == status::SUCCESS)
                 {
                     device.version = cmd.payload.long_value;
+                    identity_loaded |= IDENTITY_VERSION;
                 }
             }
         }
 
+        /**
+         * \brief send held back output reports
+         */
+        status usb::flush(const uint64_t _deadline)
+        {
+            VARIKEY_TRACE("flush", device.unique);
+            if (device_handle == INVALID_HANDLE_VALUE)
+            {
+                return status::CLOSED;
+            }
+
+            const status result = flush_pending(resolve(_deadline));
+            if (result == status::FAILURE)
+            {
+                drop_handle();
+            }
+            return result;
+        }
+
         /**
          * \brief send usb command report to the varikey gadget
          *
-         * @param handle
+         * with the coalesce policy an icon or backlight report that finds
+         * no free slot replaces an earlier one of its kind and is sent
+         * with the next report or flush
+         *
          * @param cmd
-         * @return int
+         * @param deadline absolute deadline, 0 blocks without limit
+         * @return status
          */
-        int usb::send_report(const unsigned long int handle, command &cmd)
+        status usb::send_report(command &cmd, const uint64_t deadline)
         {
-            int result = -1;
-            if ((result = ioctl(handle, HIDIOCSOUTPUT(sizeof(cmd)), (void *)&cmd)) < 0)
+            if (rate_policy == rate_controller::policy::COALESCE &&
+                rate.delay(rate_controller::now()) > 0)
+            {
+                int slot = -1;
+                if (cmd.command == static_cast<uint8_t>(varikey::command_id::ICON))
+                {
+                    slot = PENDING_ICON;
+                }
+                else if (cmd.command == static_cast<uint8_t>(varikey::command_id::BACKLIGHT))
+                {
+                    slot = PENDING_BACKLIGHT;
+                }
+
+                if (slot >= 0)
+                {
+                    if (pending_mask & (1 << slot))
+                    {
+                        ++coalesced;
+                    }
+                    pending[slot] = cmd;
+                    pending_mask |= (1 << slot);
+                    return status::SUCCESS;
+                }
+            }
+
+            status result = flush_pending(deadline);
+            if (result != status::SUCCESS)
+            {
+                return result;
+            }
+
+            return transmit(cmd, deadline);
+        }
+
+        /**
+         * \brief send coalesced reports in their slot order
+         */
+        status usb::flush_pending(const uint64_t deadline)
+        {
+            for (int i = 0; i < PENDING_COUNT && pending_mask != 0; ++i)
+            {
+                if (pending_mask & (1 << i))
+                {
+                    status result = transmit(pending[i], deadline);
+                    if (result == status::FAILURE)
+                    {
+                        pending_mask = 0;
+                        return result;
+                    }
+                    if (result != status::SUCCESS)
+                    {
+                        /* stays pending for the next attempt */
+                        return result;
+                    }
+                    pending_mask &= ~(1 << i);
+                }
+            }
+            return status::SUCCESS;
+        }
+
+        /**
+         * \brief send output report in the next free rate slot
+         *
+         * a rate slot beyond the deadline is a timeout without transfer
+         *
+         * @param cmd
+         * @param deadline absolute deadline, 0 blocks without limit
+         * @return status
+         */
+        status usb::transmit(command &cmd, const uint64_t deadline)
+        {
+            uint64_t start = rate_controller::now();
+            if (rate_policy != rate_controller::policy::NONE)
+            {
+                uint64_t wait = rate.delay(start);
+                if (wait > 0)
+                {
+                    if (deadline != 0 && start + wait > deadline)
+                    {
+                        ++timeouts;
+                        return status::TIMEOUT;
+                    }
+                    rate_controller::wait(wait);
+                    start = rate_controller::now();
+                }
+            }
+            rate.sent(start);
+
+            const size_t length = report_layout.get_transfer_length(report_descriptor::type::OUTPUT, cmd.report, sizeof(cmd));
+
+            const status result = control(HIDIOCSOUTPUT(length), (void *)&cmd, length, deadline);
+            if (result == status::FAILURE)
             {
-                perror("error sending output report");
-                fprintf(stderr, "error sending output report: %d %s\n", errno, strerror(errno));
+                log::post(log::severity::ERROR, log::event::OUTPUT_FAILED, device.unique, cmd.report, errno);
             }
+            else if (result == status::TIMEOUT)
+            {
+                log::post(log::severity::WARNING, log::event::CALL_TIMEOUT, device.unique, cmd.report);
+            }
+
+            const uint64_t end = rate_controller::now();
+            rate.completed(end - start, result == status::SUCCESS, end);
             return result;
         }
 
         /**
          * \brief send usb feature report to the varikey gadget
          *
-         * @param handle
          * @param cmd
-         * @return int
+         * @param deadline absolute deadline, 0 blocks without limit
+         * @return status
          */
-        int usb::send_report(const unsigned long int handle, feature &cmd)
+        status usb::send_report(feature &cmd, const uint64_t deadline)
         {
-            int result = -1;
-            if ((result = ioctl(handle, HIDIOCGFEATURE(sizeof(cmd)), (void *)&cmd)) < 0)
+            const uint64_t start = rate_controller::now();
+
+            const size_t length = report_layout.get_transfer_length(report_descriptor::type::FEATURE, cmd.report, sizeof(cmd));
+
+            const status result = control(HIDIOCGFEATURE(length), (void *)&cmd, length, deadline);
+            if (result == status::FAILURE)
             {
-                perror("error sending feature report");
-                fprintf(stderr, "error sending feature report: %d %s\n", errno, strerror(errno));
+                log::post(log::severity::ERROR, log::event::FEATURE_FAILED, device.unique, cmd.report, errno);
             }
+            else if (result == status::TIMEOUT)
+            {
+                log::post(log::severity::WARNING, log::event::CALL_TIMEOUT, device.unique, cmd.report);
+            }
+
+            const uint64_t end = rate_controller::now();
+            rate.completed(end - start, result == status::SUCCESS, end);
             return result;
         }
+
+        /**
+         * \brief absolute deadline of a call
+         *
+         * @param deadline absolute deadline of the caller, 0 for the default timeout
+         * @return uint64_t absolute deadline, 0 without limit
+         */
+        uint64_t usb::resolve(const uint64_t deadline) const
+        {
+            if (deadline != 0 || timeout == 0)
+            {
+                return deadline;
+            }
+            return rate_controller::now() + timeout;
+        }
+
+        /**
+         * \brief device ioctl bounded by a deadline
+         *
+         * without deadline the ioctl runs in the caller, otherwise on the
+         * device worker, errno is set on failure
+         *
+         * @param request ioctl request
+         * @param argument ioctl argument
+         * @param size argument size
+         * @param deadline absolute deadline, 0 blocks without limit
+         * @return status
+         */
+        status usb::control(const unsigned long request, void *argument, const size_t size, const uint64_t deadline)
+        {
+            VARIKEY_TRACE("ioctl", device.unique);
+            if (device_handle == INVALID_HANDLE_VALUE)
+            {
+                return status::CLOSED;
+            }
+
+            if (deadline == 0)
+            {
+                return (link->control(device_handle, request, argument) < 0) ? status::FAILURE : status::SUCCESS;
+            }
+
+            if (!worker)
+            {
+                worker.reset(new io_worker(link));
+            }
+
+            int result = -1;
+            int error = 0;
+            switch (worker->call_ioctl(device_handle, request, argument, size, deadline, result, error))
+            {
+            case io_worker::outcome::DONE:
+                errno = error;
+                return (result < 0) ? status::FAILURE : status::SUCCESS;
+            case io_worker::outcome::TIMEOUT:
+                ++timeouts;
+                return status::TIMEOUT;
+            case io_worker::outcome::BUSY:
+                break;
+            }
+            return status::BUSY;
+        }
     }
-}
\ No newline at end of file
+}
@@ -9,10 +9,20 @@
 #ifndef __VARIKEY_GADGET_USB_HPP__
 #define __VARIKEY_GADGET_USB_HPP__
 
+#include <memory>
+#include <string_view>
+
+#include "varikey_capability.hpp"
 #include "varikey_command.hpp"
+#include "varikey_descriptor.hpp"
 #include "varikey_device.hpp"
+#include "varikey_rate.hpp"
+#include "varikey_snapshot.hpp"
+#include "varikey_transport.hpp"
+#include "varikey_worker.hpp"
 
 #define INVALID_HANDLE_VALUE 0xffff
+#define VARIKEY_INPUT_LIMIT 4 /* input interfaces beside the control interface */
 
 namespace varikey
 {
@@ -24,42 +34,141 @@ namespace varikey
             usb();
             virtual ~usb();
 
-            void usb_open(const char *device_path);
+            status usb_open(const char *device_path, const uint64_t deadline = 0);
             void usb_init();
             void usb_close();
 
             uint32_t get_unique() const { return device.unique; }
-            gadget::type get_gadget() const { return device.gadget; }
-            uint32_t get_hardware() const { return device.hardware; }
-            uint32_t get_version() const { return device.version; }
+            bool has_unique() const { return identity_loaded & IDENTITY_UNIQUE; }
+            const uint8_t *get_serial();
+            gadget::type get_gadget();
+            uint8_t get_capabilities();
+            bool supports(const command &cmd) { return gadget::supports(get_capabilities(), cmd.command); }
+            uint32_t get_hardware();
+            uint32_t get_version();
 
-            void reset_device();
+            status reset_device(const uint64_t deadline = 0);
             bool is_open() const { return device_handle != INVALID_HANDLE_VALUE; }
             bool is_valid() const { return device_valid; }
+            int get_handle() const { return is_open() ? static_cast<int>(device_handle) : -1; }
+
+            status set_position(const int line, const int column, const uint64_t deadline = 0);
+            status draw_icon(const int icon, const uint64_t deadline = 0);
+            status set_font_size(const int font_size, const uint64_t deadline = 0);
+            status print_text(const std::string_view text, const uint64_t deadline = 0);
+            status set_backlight_mode(const int mode, const uint64_t deadline = 0);
+            status set_backlight_color(const uint8_t r, const uint8_t g, const uint8_t b, const uint64_t deadline = 0);
+            status send_command(command &cmd, const uint64_t deadline = 0);
+            status send_commands(command *cmds, const size_t count, const uint64_t deadline = 0);
+            bool supports_compound() { return get_version() >= VARIKEY_COMPOUND_VERSION; }
+
+            const snapshot &get_snapshot() const { return state; }
+            size_t restore();
+
+            status get_temperature(float &value, const uint64_t deadline = 0);
+
+            int read_input(uint8_t *buffer, const size_t size, const int timeout);
+            void set_inputs(const char (*paths)[VARIKEY_PATH_SIZE], const size_t count);
+            size_t get_input_count() const { return input_count; }
+            int get_input_handle(const size_t index) const { return input_handle[index]; }
+
+            const report_descriptor &get_report_descriptor() const { return report_layout; }
+
+            void set_rate_policy(const rate_controller::policy _policy) { rate_policy = _policy; }
+            uint64_t get_send_delay(const uint64_t now) const { return (rate_policy == rate_controller::policy::NONE) ? 0 : rate.delay(now); }
+            rate_controller &get_rate_controller() { return rate; }
+            uint64_t get_coalesced() const { return coalesced; }
+            status flush(const uint64_t deadline = 0);
 
-            void set_position(const int line, const int column);
-            void draw_icon(const int icon);
-            void set_font_size(const int font_size);
-            void print_text(const char *text);
-            void set_backlight_mode(const int mode);
-            void set_backlight_color(const uint8_t r, const uint8_t g, const uint8_t b);
+            void set_transport(std::shared_ptr<transport>);
 
-            float get_temperature();
+            void set_timeout(const uint64_t _timeout) { timeout = _timeout; }
+            uint64_t get_timeout() const { return timeout; }
+            uint64_t get_timeouts() const { return timeouts; }
 
         private:
+            /**
+             * \brief identity fields, read on demand and memoized
+             * @{
+             */
+            enum identity : uint8_t
+            {
+                IDENTITY_SERIAL = 0x01,
+                IDENTITY_UNIQUE = 0x02,
+                IDENTITY_GADGET = 0x04,
+                IDENTITY_HARDWARE = 0x08,
+                IDENTITY_VERSION = 0x10,
+            };
+            /** }@ */
+
+            void load_identity(const identity);
+            void usb_get_descriptor();
+
             void usb_get_serial();
             void usb_get_unique();
             void usb_get_gadget();
             void usb_get_hardware();
             void usb_get_version();
 
-            int send_report(const unsigned long int handle, command &cmd);
-            int send_report(const unsigned long int handle, feature &cmd);
+            status send_report(command &cmd, const uint64_t deadline);
+            status send_report(feature &cmd, const uint64_t deadline);
+            status transmit(command &cmd, const uint64_t deadline);
+            status flush_pending(const uint64_t deadline);
 
-            varikey::device device;
+            uint64_t resolve(const uint64_t deadline) const;
+            status control(const unsigned long request, void *argument, const size_t size, const uint64_t deadline);
+            void drop_handle();
 
+            varikey::device device{};
+            char device_path[VARIKEY_PATH_SIZE]{};
+            uint8_t identity_loaded{0};
+            uint8_t identity_attempted{0}; /* reads tried, a failed read is not retried until the path changes or init */
+            report_descriptor report_layout;
+            snapshot state;
+
+            std::shared_ptr<transport> link{transport::hidraw()};
             unsigned long int device_handle{INVALID_HANDLE_VALUE};
             bool device_valid{false};
+
+            /**
+             * \brief input interfaces of the same gadget, opened and closed
+             * with the control interface, key and consumer reports only
+             * @{
+             */
+            void open_inputs();
+            void close_inputs();
+            char input_path[VARIKEY_INPUT_LIMIT][VARIKEY_PATH_SIZE]{};
+            int input_handle[VARIKEY_INPUT_LIMIT];
+            size_t input_count{0};
+            /** }@ */
+
+            /**
+             * \brief deadline enforcement, a call without deadline uses the
+             * default timeout, without both it blocks in the caller
+             * @{
+             */
+            uint64_t timeout{0};
+            uint64_t timeouts{0};
+            std::unique_ptr<io_worker> worker;
+            /** }@ */
+
+            /**
+             * \brief output reports superseded by a newer one of the same kind
+             * @{
+             */
+            enum pending_report : uint8_t
+            {
+                PENDING_ICON = 0,
+                PENDING_BACKLIGHT,
+                PENDING_COUNT,
+            };
+            /** }@ */
+
+            rate_controller rate;
+            rate_controller::policy rate_policy{rate_controller::policy::HOLD};
+            command pending[PENDING_COUNT];
+            uint8_t pending_mask{0};
+            uint64_t coalesced{0};
         };
     }
 }
@@ -0,0 +1,109 @@
+/**
+ * \file varikey_group.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <ctime>
+#include <thread>
+
+#include "varikey_group.hpp"
+#include "varikey_rate.hpp"
+
+namespace varikey
+{
+    /**
+     * \brief add a gadget with its prepared reports
+     *
+     * @param gadget open gadget
+     * @param commands encoded reports, sent in order
+     * @param count number of reports
+     * @return false if there are too many reports
+     *
+     * reports the gadget type cannot perform are left out up front, the
+     * firmware version deciding on compound reports is read here as well
+     */
+    bool group::add(gadget::usb &_gadget, const command *_commands, const size_t _count)
+    {
+        if (_count > VARIKEY_GROUP_COMMANDS)
+        {
+            return false;
+        }
+
+        member item;
+        item.gadget = &_gadget;
+        item.count = 0;
+        for (size_t i = 0; i < _count; ++i)
+        {
+            if (_gadget.supports(_commands[i]))
+            {
+                item.commands[item.count++] = _commands[i];
+            }
+        }
+        item.start = 0;
+        item.end = 0;
+        _gadget.supports_compound();
+        members.push_back(item);
+        return true;
+    }
+
+    /**
+     * \brief release all prepared reports at one deadline
+     *
+     * @param lead time from now to the deadline in ns, covers thread start
+     * @return skew measured skew of the group
+     */
+    group::skew group::execute(const uint64_t _lead)
+    {
+        skew result = {0, 0, 0};
+        if (members.empty())
+        {
+            return result;
+        }
+
+        const uint64_t deadline = rate_controller::now() + _lead;
+
+        std::vector<std::thread> workers;
+        workers.reserve(members.size());
+        for (auto &i : members)
+        {
+            workers.emplace_back(&group::release, std::ref(i), deadline);
+        }
+        for (auto &i : workers)
+        {
+            i.join();
+        }
+
+        uint64_t first_start = UINT64_MAX, last_start = 0;
+        uint64_t first_end = UINT64_MAX, last_end = 0;
+        for (auto const &i : members)
+        {
+            first_start = std::min(first_start, i.start);
+            last_start = std::max(last_start, i.start);
+            first_end = std::min(first_end, i.end);
+            last_end = std::max(last_end, i.end);
+        }
+
+        result.release = last_start - first_start;
+        result.completion = last_end - first_end;
+        result.lateness = (last_start > deadline) ? last_start - deadline : 0;
+        return result;
+    }
+
+    void group::release(member &_member, const uint64_t _deadline)
+    {
+        struct timespec absolute;
+        absolute.tv_sec = _deadline / 1000000000ULL;
+        absolute.tv_nsec = _deadline % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &absolute, nullptr) != 0)
+        {
+        }
+
+        _member.start = rate_controller::now();
+        _member.gadget->send_commands(_member.commands, _member.count);
+        _member.end = rate_controller::now();
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * \file varikey_group.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_GROUP_HPP__
+#define __VARIKEY_GROUP_HPP__
+
+#include <cstdint>
+#include <vector>
+
+#include "varikey_command.hpp"
+#include "varikey_gadget_usb.hpp"
+
+#define VARIKEY_GROUP_COMMANDS 8
+#define VARIKEY_GROUP_LEAD 20000000ULL /* ns, default lead time to the deadline */
+
+namespace varikey
+{
+    /**
+     * \brief time synchronized command execution on several gadgets
+     *
+     * All reports are encoded up front. On execute every member gets its
+     * own thread which sleeps on CLOCK_MONOTONIC to one absolute deadline
+     * and sends its prepared reports, packed into compound reports where
+     * the firmware supports them; release and completion times are
+     * recorded to report the inter-device skew.
+     */
+    class group
+    {
+    public:
+        struct skew
+        {
+            uint64_t release;    /* ns between first and last report start */
+            uint64_t completion; /* ns between first and last report end */
+            uint64_t lateness;   /* ns of the latest start behind the deadline */
+        };
+
+        group() {}
+        virtual ~group() {}
+
+        bool add(gadget::usb &, const command *commands, const size_t count);
+        void clear() { members.clear(); }
+        size_t size() const { return members.size(); }
+
+        skew execute(const uint64_t lead);
+
+    private:
+        struct member
+        {
+            gadget::usb *gadget;
+            command commands[VARIKEY_GROUP_COMMANDS];
+            size_t count;
+            uint64_t start;
+            uint64_t end;
+        };
+
+        static void release(member &, const uint64_t deadline);
+
+        std::vector<member> members;
+    };
+}
+
+#endif /* __VARIKEY_GROUP_HPP__ */
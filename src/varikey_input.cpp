@@ -0,0 +1,119 @@
+/**
+ * \file varikey_input.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cstring>
+
+#include "varikey_command.hpp"
+#include "varikey_input.hpp"
+
+/**
+ * \brief consumer usages of the rotary encoder
+ * @{
+ */
+#define CONSUMER_VOLUME_UP 0x00e9
+#define CONSUMER_VOLUME_DOWN 0x00ea
+/** }@ */
+
+static bool contains(const uint8_t *keys, const uint8_t code);
+
+namespace varikey
+{
+    namespace input
+    {
+        /**
+         * \brief decode one input report
+         *
+         * @param report raw report starting with the report id
+         * @param length report length
+         * @param timestamp receive time
+         * @param events event buffer
+         * @param capacity event buffer size
+         * @return size_t number of decoded events
+         */
+        size_t decoder::decode(const uint8_t *_report, const size_t _length, const uint64_t _timestamp,
+                               event *_events, const size_t _capacity)
+        {
+            size_t count = 0;
+            if (_length < 1)
+            {
+                return count;
+            }
+
+            switch (static_cast<report_id>(_report[0]))
+            {
+            case report_id::KEYBOARD:
+            {
+                if (_length < 3 + VARIKEY_KEYBOARD_KEYS)
+                {
+                    break;
+                }
+
+                const uint8_t *current = _report + 3;
+                for (int i = 0; i < VARIKEY_KEYBOARD_KEYS && count < _capacity; ++i)
+                {
+                    if (keys[i] != 0 && !contains(current, keys[i]))
+                    {
+                        _events[count++] = {type::KEY_RELEASE, keys[i], 0, _timestamp};
+                    }
+                }
+                for (int i = 0; i < VARIKEY_KEYBOARD_KEYS && count < _capacity; ++i)
+                {
+                    if (current[i] != 0 && !contains(keys, current[i]))
+                    {
+                        _events[count++] = {type::KEY_PRESS, current[i], 0, _timestamp};
+                    }
+                }
+                memcpy(keys, current, sizeof(keys));
+            }
+            break;
+            case report_id::CONSUMER:
+            {
+                if (_length < 3 || _capacity == 0)
+                {
+                    break;
+                }
+
+                const uint16_t usage = _report[1] | (_report[2] << 8);
+                if (usage == CONSUMER_VOLUME_UP)
+                {
+                    _events[count++] = {type::ENCODER, 0, 1, _timestamp};
+                }
+                else if (usage == CONSUMER_VOLUME_DOWN)
+                {
+                    _events[count++] = {type::ENCODER, 0, -1, _timestamp};
+                }
+            }
+            break;
+            default:
+                break;
+            }
+
+            return count;
+        }
+
+        /**
+         * \brief forget pressed keys, e.g. after reopen
+         */
+        void decoder::reset()
+        {
+            memset(keys, 0, sizeof(keys));
+        }
+    }
+}
+
+static bool contains(const uint8_t *_keys, const uint8_t _code)
+{
+    for (int i = 0; i < VARIKEY_KEYBOARD_KEYS; ++i)
+    {
+        if (_keys[i] == _code)
+        {
+            return true;
+        }
+    }
+    return false;
+}
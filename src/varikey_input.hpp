@@ -0,0 +1,60 @@
+/**
+ * \file varikey_input.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_INPUT_HPP__
+#define __VARIKEY_INPUT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#define VARIKEY_KEYBOARD_KEYS 6
+#define VARIKEY_INPUT_REPORT_SIZE 64
+
+namespace varikey
+{
+    namespace input
+    {
+        enum class type : uint8_t
+        {
+            KEY_PRESS = 0,
+            KEY_RELEASE,
+            ENCODER,
+        };
+
+        struct event
+        {
+            type kind;
+            uint8_t code;       /* keyboard usage of a key */
+            int8_t value;       /* encoder direction, +1 clockwise, -1 counter clockwise */
+            uint64_t timestamp; /* monotonic ns */
+        };
+
+        /**
+         * \brief decode gadget input reports into events
+         *
+         * keyboard reports are compared with the previous one of the same
+         * gadget, every new key code is a press and every vanished one a
+         * release; the encoder reports volume up/down consumer usages
+         */
+        class decoder
+        {
+        public:
+            decoder() {}
+            virtual ~decoder() {}
+
+            size_t decode(const uint8_t *report, const size_t length, const uint64_t timestamp,
+                          event *events, const size_t capacity);
+            void reset();
+
+        private:
+            uint8_t keys[VARIKEY_KEYBOARD_KEYS]{};
+        };
+    }
+}
+
+#endif /* __VARIKEY_INPUT_HPP__ */
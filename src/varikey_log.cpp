@@ -0,0 +1,301 @@
+/**
+ * \file varikey_log.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "varikey_log.hpp"
+#include "varikey_rate.hpp"
+
+/**
+ * \brief multiplicative hash of a device unique
+ */
+#define LOG_HASH(unique) ((unique) * 2654435761U)
+
+static const char *const LOG_SEVERITY[] = {"debug", "info", "warning", "error"};
+
+static const char *const LOG_EVENT[] = {
+    "timeout opening device",
+    "error reading device name",
+    "error reading report descriptor",
+    "error sending output report",
+    "error sending feature report",
+    "error reading input report",
+    "timeout on device",
+};
+
+static void flush_at_exit();
+
+namespace varikey
+{
+    namespace log
+    {
+        /**
+         * \brief process wide logger
+         *
+         * never destroyed, gadgets closing during static destruction may
+         * still log; pending records are written at exit
+         */
+        logger &logger::instance()
+        {
+            static logger *object = []
+            {
+                logger *created = new logger();
+                std::atexit(flush_at_exit);
+                return created;
+            }();
+            return *object;
+        }
+
+        logger::logger()
+        {
+            for (uint64_t i = 0; i < VARIKEY_LOG_CAPACITY; ++i)
+            {
+                ring[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            memset(windows, 0, sizeof(windows));
+
+            wake_handle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_handle < 0)
+            {
+                fprintf(stderr, "error creating eventfd: %d %s\n", errno, strerror(errno));
+            }
+
+            writer = std::thread(&logger::run, this);
+            writer.detach();
+        }
+
+        /**
+         * \brief queue a record, drop it if the ring is full
+         */
+        void logger::push(const severity _level, const event _what, const uint32_t _unique,
+                          const uint8_t _report, const int _error)
+        {
+            if (_level < level.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            uint64_t position = tail.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                cell &slot = ring[position & (VARIKEY_LOG_CAPACITY - 1)];
+                const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                const int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+
+                if (difference == 0)
+                {
+                    if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        slot.value = {rate_controller::now(), _unique, _error, _level, _what, _report};
+                        slot.sequence.store(position + 1, std::memory_order_release);
+
+                        /* only the first record after the writer slept pays the wakeup */
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false))
+                        {
+                            const uint64_t one = 1;
+                            (void)!write(wake_handle, &one, sizeof(one));
+                        }
+                        return;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    ++overflows;
+                    return;
+                }
+                else
+                {
+                    position = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * \brief write all queued records and suppression counters now
+         */
+        void logger::flush()
+        {
+            drain(true);
+        }
+
+        /**
+         * \brief write queued records, close elapsed rate limit windows
+         */
+        void logger::drain(const bool _final)
+        {
+            std::lock_guard<std::mutex> guard(drain_lock);
+
+            record value;
+            while (pop(value))
+            {
+                emit(value);
+            }
+
+            const uint64_t lost = overflows.load();
+            if (lost != reported_overflows)
+            {
+                fprintf(stderr, "log: %llu records lost\n", static_cast<unsigned long long>(lost - reported_overflows));
+                reported_overflows = lost;
+            }
+
+            for (auto &i : windows)
+            {
+                if (i.suppressed > 0 && (_final || rate_controller::now() - i.start >= VARIKEY_LOG_WINDOW))
+                {
+                    close_window(i);
+                }
+            }
+        }
+
+        /**
+         * \brief take the oldest record, single consumer under drain_lock
+         */
+        bool logger::pop(record &_value)
+        {
+            cell &slot = ring[head & (VARIKEY_LOG_CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            {
+                return false;
+            }
+
+            _value = slot.value;
+            slot.sequence.store(head + VARIKEY_LOG_CAPACITY, std::memory_order_release);
+            ++head;
+            return true;
+        }
+
+        /**
+         * \brief drain, then sleep until a record arrives or a window with
+         * suppressed records closes
+         *
+         * the interval between two drains batches records and limits the
+         * wakeups a busy producer causes
+         */
+        void logger::run()
+        {
+            for (;;)
+            {
+                drain(false);
+                std::this_thread::sleep_for(std::chrono::milliseconds(VARIKEY_LOG_INTERVAL));
+
+                sleeping.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int timeout = -1;
+                if (wake_handle >= 0 && idle(timeout))
+                {
+                    struct pollfd wake = {wake_handle, POLLIN, 0};
+                    poll(&wake, 1, timeout);
+                }
+                sleeping.store(false);
+
+                uint64_t value;
+                while (wake_handle >= 0 && read(wake_handle, &value, sizeof(value)) > 0)
+                {
+                }
+            }
+        }
+
+        /**
+         * \brief ring is empty, timeout is set to the ms until the first
+         * window with suppressed records closes or -1
+         */
+        bool logger::idle(int &_timeout)
+        {
+            std::lock_guard<std::mutex> guard(drain_lock);
+
+            if (ring[head & (VARIKEY_LOG_CAPACITY - 1)].sequence.load(std::memory_order_acquire) == head + 1 ||
+                overflows.load() != reported_overflows)
+            {
+                return false;
+            }
+
+            const uint64_t now = rate_controller::now();
+            _timeout = -1;
+            for (auto const &i : windows)
+            {
+                if (i.suppressed > 0)
+                {
+                    const uint64_t elapsed = now - i.start;
+                    const int remaining = (elapsed >= VARIKEY_LOG_WINDOW)
+                                              ? 0
+                                              : static_cast<int>((VARIKEY_LOG_WINDOW - elapsed + 999999) / 1000000);
+                    _timeout = (_timeout < 0) ? remaining : std::min(_timeout, remaining);
+                }
+            }
+            return true;
+        }
+
+        /**
+         * \brief format a record, at most a burst per device and window
+         */
+        void logger::emit(const record &_value)
+        {
+            device_window &current = window(_value.unique);
+            if (_value.timestamp - current.start >= VARIKEY_LOG_WINDOW)
+            {
+                close_window(current);
+                current.start = _value.timestamp;
+            }
+
+            if (current.count >= VARIKEY_LOG_BURST)
+            {
+                ++current.suppressed;
+                ++suppressed;
+                return;
+            }
+            ++current.count;
+
+            fprintf(stderr, "%s: device %u report %u: %s", LOG_SEVERITY[static_cast<int>(_value.level)],
+                    _value.unique, _value.report, LOG_EVENT[static_cast<int>(_value.what)]);
+            if (_value.error != 0)
+            {
+                fprintf(stderr, ": %d %s", _value.error, strerror(_value.error));
+            }
+            fputc('\n', stderr);
+        }
+
+        /**
+         * \brief rate limit slot of a device, a colliding device takes it over
+         */
+        logger::device_window &logger::window(const uint32_t _unique)
+        {
+            device_window &slot = windows[LOG_HASH(_unique) & (VARIKEY_LOG_DEVICES - 1)];
+            if (slot.unique != _unique)
+            {
+                close_window(slot);
+                slot.unique = _unique;
+                slot.start = 0;
+            }
+            return slot;
+        }
+
+        void logger::close_window(device_window &_window)
+        {
+            if (_window.suppressed > 0)
+            {
+                fprintf(stderr, "device %u: %u messages suppressed\n", _window.unique, _window.suppressed);
+            }
+            _window.count = 0;
+            _window.suppressed = 0;
+        }
+    }
+}
+
+static void flush_at_exit()
+{
+    varikey::log::logger::instance().flush();
+}
@@ -0,0 +1,141 @@
+/**
+ * \file varikey_log.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_LOG_HPP__
+#define __VARIKEY_LOG_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/**
+ * \brief log ring and rate limit
+ * @{
+ */
+#define VARIKEY_LOG_CAPACITY 1024  /* records in the ring, power of two */
+#define VARIKEY_LOG_DEVICES 64     /* rate limited devices, power of two */
+#define VARIKEY_LOG_BURST 5        /* records per device and window */
+#define VARIKEY_LOG_WINDOW 1000000000ULL /* ns */
+#define VARIKEY_LOG_INTERVAL 20    /* ms at least between two drains */
+/** }@ */
+
+namespace varikey
+{
+    namespace log
+    {
+        enum class severity : uint8_t
+        {
+            DEBUG,
+            INFO,
+            WARNING,
+            ERROR,
+        };
+
+        /**
+         * \brief what happened, the text is added by the writer thread
+         */
+        enum class event : uint8_t
+        {
+            OPEN_TIMEOUT,
+            NAME_FAILED,
+            DESCRIPTOR_FAILED,
+            OUTPUT_FAILED,
+            FEATURE_FAILED,
+            INPUT_FAILED,
+            CALL_TIMEOUT,
+        };
+
+        struct record
+        {
+            uint64_t timestamp;
+            uint32_t unique;
+            int error;
+            severity level;
+            event what;
+            uint8_t report;
+        };
+
+        /**
+         * \brief asynchronous structured logger
+         *
+         * Producers copy a fixed size record into a bounded lock-free
+         * multi-producer ring and never block or format; a full ring drops
+         * the record and counts it. A writer thread sleeps until the first
+         * record wakes it, drains the ring at most every few milliseconds,
+         * formats to stderr and limits every device to a burst per window,
+         * the number of suppressed records is printed when the window
+         * closes.
+         */
+        class logger
+        {
+        public:
+            static logger &instance();
+
+            void push(const severity, const event, const uint32_t unique, const uint8_t report, const int error);
+            void flush();
+
+            void set_level(const severity _level) { level = _level; }
+            uint64_t get_overflows() const { return overflows; }
+            uint64_t get_suppressed() const { return suppressed; }
+
+        private:
+            struct cell
+            {
+                std::atomic<uint64_t> sequence;
+                record value;
+            };
+
+            struct device_window
+            {
+                uint32_t unique;
+                uint64_t start;
+                uint32_t count;
+                uint32_t suppressed;
+            };
+
+            logger();
+            ~logger() = delete;
+
+            bool pop(record &);
+            void drain(const bool final);
+            void run();
+            bool idle(int &timeout);
+            void emit(const record &);
+            device_window &window(const uint32_t unique);
+            void close_window(device_window &);
+
+            cell ring[VARIKEY_LOG_CAPACITY];
+            alignas(64) std::atomic<uint64_t> tail{0};
+            alignas(64) uint64_t head{0};
+
+            std::atomic<severity> level{severity::INFO};
+            std::atomic<uint64_t> overflows{0};
+            uint64_t reported_overflows{0};
+            std::atomic<uint64_t> suppressed{0};
+
+            device_window windows[VARIKEY_LOG_DEVICES];
+
+            std::mutex drain_lock;
+            std::thread writer;
+            int wake_handle{-1};               /* eventfd, written by the first push after the writer slept */
+            std::atomic<bool> sleeping{false}; /* writer waits for wake_handle */
+        };
+
+        /**
+         * \brief log from the I/O path, never blocks
+         */
+        inline void post(const severity _level, const event _what, const uint32_t _unique,
+                         const uint8_t _report = 0, const int _error = 0)
+        {
+            logger::instance().push(_level, _what, _unique, _report, _error);
+        }
+    }
+}
+
+#endif /* __VARIKEY_LOG_HPP__ */
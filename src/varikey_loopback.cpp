@@ -0,0 +1,425 @@
+/**
+ * \file varikey_loopback.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/hidraw.h>
+#include <linux/input.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "varikey_loopback.hpp"
+#include "varikey_rate.hpp"
+
+/**
+ * \brief identity reported by every loopback gadget
+ * @{
+ */
+#define LOOPBACK_VENDOR 0xcafe
+#define LOOPBACK_PRODUCT 0x4004
+#define LOOPBACK_TEMPERATURE 42500 /* m°C */
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief loopback without gadgets
+     *
+     * @param seed start of the pseudo random sequence driving the faults
+     */
+    loopback::loopback(const uint32_t _seed) : random(_seed ? _seed : 1) {}
+
+    loopback::~loopback()
+    {
+        for (auto &i : gadgets)
+        {
+            for (auto handle : i.handles)
+            {
+                ::close(handle);
+            }
+        }
+    }
+
+    /**
+     * \brief add a gadget, opened by its path
+     *
+     * @param path any name, it is not a file
+     * @param identity unique, gadget type, revisions, serial and name
+     */
+    void loopback::add_device(const char *_path, const device &_identity)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state item{};
+        item.path = _path;
+        item.identity = _identity;
+        item.identity.bustype = BUS_USB;
+        item.identity.vendor = LOOPBACK_VENDOR;
+        item.identity.product = LOOPBACK_PRODUCT;
+        item.plugged = true;
+        gadgets.push_back(item);
+    }
+
+    void loopback::configure(const fault &_fault)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        faults = _fault;
+    }
+
+    /**
+     * \brief queue an input report, a full queue drops it
+     */
+    bool loopback::inject_input(const char *_path, const uint8_t *_report, const size_t _length)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_path(_path);
+        if (item == nullptr || !item->plugged || item->input_count == VARIKEY_LOOPBACK_INPUT)
+        {
+            return false;
+        }
+
+        const size_t slot = (item->input_head + item->input_count) % VARIKEY_LOOPBACK_INPUT;
+        item->input_length[slot] = std::min<size_t>(_length, VARIKEY_INPUT_REPORT_SIZE);
+        memcpy(item->input[slot], _report, item->input_length[slot]);
+        ++item->input_count;
+
+        signal_handles(*item, 1);
+        return true;
+    }
+
+    /**
+     * \brief disconnect a gadget, open handles fail and become readable
+     */
+    void loopback::unplug(const char *_path)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_path(_path);
+        if (item != nullptr && item->plugged)
+        {
+            item->plugged = false;
+            item->input_count = 0;
+            signal_handles(*item, 1);
+        }
+    }
+
+    void loopback::plug(const char *_path)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_path(_path);
+        if (item != nullptr)
+        {
+            item->plugged = true;
+            item->count.requests = 0;
+        }
+    }
+
+    loopback::counters loopback::get_counters(const char *_path)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_path(_path);
+        return (item != nullptr) ? item->count : counters{};
+    }
+
+    /**
+     * \brief last received command of a kind
+     */
+    bool loopback::get_last(const char *_path, const command_id _id, command &_command)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_path(_path);
+        const size_t index = static_cast<size_t>(_id);
+        if (item == nullptr || index >= 8 || item->count.per_command[index] == 0)
+        {
+            return false;
+        }
+        _command = item->last[index];
+        return true;
+    }
+
+    int loopback::open(const char *_path, const int)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_path(_path);
+        if (item == nullptr || !item->plugged)
+        {
+            errno = ENOENT;
+            return -1;
+        }
+
+        /* semaphore counter, one readable unit per queued report */
+        const int handle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC | EFD_SEMAPHORE);
+        if (handle < 0)
+        {
+            return -1;
+        }
+        item->handles.push_back(handle);
+        if (item->input_count > 0)
+        {
+            const uint64_t value = item->input_count;
+            (void)!::write(handle, &value, sizeof(value));
+        }
+        return handle;
+    }
+
+    int loopback::close(const int _handle)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for (auto &i : gadgets)
+        {
+            auto position = std::find(i.handles.begin(), i.handles.end(), _handle);
+            if (position != i.handles.end())
+            {
+                i.handles.erase(position);
+                return ::close(_handle);
+            }
+        }
+
+        errno = EBADF;
+        return -1;
+    }
+
+    /**
+     * \brief answer a hidraw request after the injected latency
+     */
+    int loopback::control(const int _handle, const unsigned long _request, void *_argument)
+    {
+        uint64_t delay = 0;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            delay = faults.latency + ((faults.jitter > 0) ? next_random() % (faults.jitter + 1) : 0);
+        }
+        if (delay > 0)
+        {
+            rate_controller::wait(delay);
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_handle(_handle);
+        if (item == nullptr)
+        {
+            errno = EBADF;
+            return -1;
+        }
+        if (!item->plugged)
+        {
+            errno = ENODEV;
+            return -1;
+        }
+
+        ++item->count.requests;
+        if (faults.disconnect > 0 && item->count.requests >= faults.disconnect)
+        {
+            item->plugged = false;
+            item->input_count = 0;
+            signal_handles(*item, 1);
+            errno = ENODEV;
+            return -1;
+        }
+
+        if (faults.error_rate > 0 && next_random() % 1000000 < faults.error_rate)
+        {
+            ++item->count.errors;
+            errno = EIO;
+            return -1;
+        }
+
+        const size_t size = _IOC_SIZE(_request);
+        uint8_t *argument = static_cast<uint8_t *>(_argument);
+
+        switch (_IOC_NR(_request))
+        {
+        case _IOC_NR(HIDIOCGRDESCSIZE):
+            /* no descriptor, reports use the packed structure lengths */
+            *static_cast<int *>(_argument) = 0;
+            return 0;
+        case _IOC_NR(HIDIOCGRAWINFO):
+        {
+            struct hidraw_devinfo *info = static_cast<struct hidraw_devinfo *>(_argument);
+            info->bustype = item->identity.bustype;
+            info->vendor = item->identity.vendor;
+            info->product = item->identity.product;
+        }
+            return 0;
+        case _IOC_NR(HIDIOCGRAWNAME(0)):
+        {
+            const size_t length = std::min(size, strnlen(item->identity.name, sizeof(item->identity.name)) + 1);
+            memcpy(argument, item->identity.name, length);
+            return static_cast<int>(length);
+        }
+        case _IOC_NR(HIDIOCGFEATURE(0)):
+            ++item->count.features;
+            return answer_feature(*item, argument, size);
+        case _IOC_NR(HIDIOCSOUTPUT(0)):
+            ++item->count.outputs;
+            accept_output(*item, argument, size);
+            return static_cast<int>(size);
+        }
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    /**
+     * \brief take the oldest input report
+     */
+    ssize_t loopback::read(const int _handle, void *_buffer, const size_t _size)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        gadget_state *item = find_handle(_handle);
+        if (item == nullptr)
+        {
+            errno = EBADF;
+            return -1;
+        }
+
+        uint64_t unit;
+        const bool signalled = (::read(_handle, &unit, sizeof(unit)) == sizeof(unit));
+
+        if (!item->plugged)
+        {
+            errno = ENODEV;
+            return -1;
+        }
+        if (item->input_count == 0 || !signalled)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        const size_t length = std::min(_size, item->input_length[item->input_head]);
+        memcpy(_buffer, item->input[item->input_head], length);
+        item->input_head = (item->input_head + 1) % VARIKEY_LOOPBACK_INPUT;
+        --item->input_count;
+        return static_cast<ssize_t>(length);
+    }
+
+    loopback::gadget_state *loopback::find_path(const char *_path)
+    {
+        for (auto &i : gadgets)
+        {
+            if (i.path == _path)
+            {
+                return &i;
+            }
+        }
+        return nullptr;
+    }
+
+    loopback::gadget_state *loopback::find_handle(const int _handle)
+    {
+        for (auto &i : gadgets)
+        {
+            if (std::find(i.handles.begin(), i.handles.end(), _handle) != i.handles.end())
+            {
+                return &i;
+            }
+        }
+        return nullptr;
+    }
+
+    int loopback::answer_feature(gadget_state &_gadget, uint8_t *_report, const size_t _length)
+    {
+        feature reply;
+        memset(&reply, 0, sizeof(reply));
+        reply.report = _report[0];
+
+        switch (static_cast<report_id>(_report[0]))
+        {
+        case report_id::SERIAL:
+            memcpy(reply.payload.serial, _gadget.identity.serial, sizeof(reply.payload.serial));
+            break;
+        case report_id::GADGET:
+            reply.payload.byte_value = static_cast<uint8_t>(_gadget.identity.gadget);
+            break;
+        case report_id::UNIQUE:
+            reply.payload.long_value = _gadget.identity.unique;
+            break;
+        case report_id::HARDWARE:
+            reply.payload.long_value = _gadget.identity.hardware;
+            break;
+        case report_id::VERSION:
+            reply.payload.long_value = _gadget.identity.version;
+            break;
+        case report_id::TEMPERATURE:
+            reply.payload.long_value = LOOPBACK_TEMPERATURE;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+        }
+
+        const size_t length = std::min(_length, sizeof(reply));
+        memcpy(_report, &reply, length);
+        return static_cast<int>(length);
+    }
+
+    void loopback::accept_output(gadget_state &_gadget, const uint8_t *_report, const size_t _length)
+    {
+        command cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        memcpy(&cmd, _report, std::min(_length, sizeof(cmd)));
+
+        if (cmd.report == static_cast<uint8_t>(report_id::CUSTOM))
+        {
+            decode(_gadget, cmd);
+        }
+    }
+
+    void loopback::decode(gadget_state &_gadget, const command &_command)
+    {
+        if (_command.command < 8)
+        {
+            ++_gadget.count.per_command[_command.command];
+            _gadget.last[_command.command] = _command;
+        }
+
+        if (_command.command == static_cast<uint8_t>(command_id::COMPOUND))
+        {
+            /* the compound report itself is no command */
+            command commands[VARIKEY_COMPOUND_LIMIT];
+            const size_t count = decode_compound(_command, commands, VARIKEY_COMPOUND_LIMIT);
+            for (size_t i = 0; i < count; ++i)
+            {
+                decode(_gadget, commands[i]);
+            }
+            return;
+        }
+
+        ++_gadget.count.commands;
+    }
+
+    void loopback::signal_handles(gadget_state &_gadget, const uint64_t _value)
+    {
+        for (auto handle : _gadget.handles)
+        {
+            (void)!::write(handle, &_value, sizeof(_value));
+        }
+    }
+
+    /**
+     * \brief xorshift64*, deterministic for a seed
+     */
+    uint64_t loopback::next_random()
+    {
+        random ^= random >> 12;
+        random ^= random << 25;
+        random ^= random >> 27;
+        return random * 2685821657736338717ULL;
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * \file varikey_loopback.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_LOOPBACK_HPP__
+#define __VARIKEY_LOOPBACK_HPP__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "varikey_command.hpp"
+#include "varikey_device.hpp"
+#include "varikey_input.hpp"
+#include "varikey_transport.hpp"
+
+/**
+ * \brief loopback limits
+ * @{
+ */
+#define VARIKEY_LOOPBACK_INPUT 32 /* queued input reports per gadget */
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief in-process gadgets for tests and benchmarks
+     *
+     * Every loopback gadget answers the hidraw requests gadget::usb
+     * uses: device info and name, the identity and temperature feature
+     * reports and custom output reports, which are decoded and counted,
+     * compound reports per subcommand.
+     * Input reports are injected and read back through an eventfd
+     * handle, so poll and the reactor work unchanged.
+     *
+     * Faults are injected per call: a fixed latency plus uniform jitter,
+     * an error rate and a disconnect after a number of reports. The
+     * pseudo random sequence is seeded, runs are reproducible.
+     */
+    class loopback : public transport
+    {
+    public:
+        struct fault
+        {
+            uint64_t latency;     /* ns added to every request */
+            uint64_t jitter;      /* ns, uniform 0..jitter on top */
+            uint32_t error_rate;  /* failed requests per million */
+            uint32_t disconnect;  /* unplug after this many requests, 0 never */
+        };
+
+        struct counters
+        {
+            uint64_t requests;
+            uint64_t features;
+            uint64_t outputs;
+            uint64_t commands; /* decoded subcommands of all output reports */
+            uint64_t errors;
+            uint64_t per_command[8];
+        };
+
+        explicit loopback(const uint32_t seed = 1);
+        virtual ~loopback();
+
+        void add_device(const char *path, const device &identity);
+        void configure(const fault &);
+
+        bool inject_input(const char *path, const uint8_t *report, const size_t length);
+        void unplug(const char *path);
+        void plug(const char *path);
+
+        counters get_counters(const char *path);
+        bool get_last(const char *path, const command_id, command &);
+
+        int open(const char *path, const int flags) override;
+        int close(const int handle) override;
+        int control(const int handle, const unsigned long request, void *argument) override;
+        ssize_t read(const int handle, void *buffer, const size_t size) override;
+
+    private:
+        struct gadget_state
+        {
+            std::string path;
+            device identity;
+            bool plugged;
+            counters count;
+            command last[8];
+            uint8_t input[VARIKEY_LOOPBACK_INPUT][VARIKEY_INPUT_REPORT_SIZE];
+            size_t input_length[VARIKEY_LOOPBACK_INPUT];
+            size_t input_head;
+            size_t input_count;
+            std::vector<int> handles;
+        };
+
+        gadget_state *find_path(const char *path);
+        gadget_state *find_handle(const int handle);
+        int answer_feature(gadget_state &, uint8_t *report, const size_t length);
+        void accept_output(gadget_state &, const uint8_t *report, const size_t length);
+        void decode(gadget_state &, const command &);
+        void signal_handles(gadget_state &, const uint64_t value);
+        uint64_t next_random();
+
+        std::mutex lock;
+        std::vector<gadget_state> gadgets;
+        fault faults{0, 0, 0, 0};
+        uint64_t random;
+    };
+}
+
+#endif /* __VARIKEY_LOOPBACK_HPP__ */
@@ -0,0 +1,132 @@
+/**
+ * \file varikey_rate.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <ctime>
+
+#include "varikey_rate.hpp"
+
+/**
+ * \brief default rate control parameters
+ *
+ * the initial rate does not slow down a healthy gadget, a full speed
+ * device answers a control transfer within one or two frames
+ * @{
+ */
+#define RATE_INITIAL 500.0
+#define RATE_MINIMUM 10.0
+#define RATE_MAXIMUM 1000.0
+#define RATE_INCREASE 100.0
+#define RATE_DECREASE 0.5
+#define RATE_LATENCY_TARGET 8000000ULL /* 8 ms */
+#define RATE_WINDOW 50000000ULL        /* 50 ms */
+/** }@ */
+
+#define NANOSECONDS 1000000000ULL
+
+namespace varikey
+{
+    rate_controller::rate_controller()
+    {
+        configure({RATE_INITIAL, RATE_MINIMUM, RATE_MAXIMUM, RATE_INCREASE, RATE_DECREASE,
+                   RATE_LATENCY_TARGET, RATE_WINDOW});
+    }
+
+    /**
+     * \brief set parameters and restart with the initial rate
+     */
+    void rate_controller::configure(const parameter &_setup)
+    {
+        setup = _setup;
+        reset();
+    }
+
+    /**
+     * \brief restart with the initial rate, e.g. after reopen
+     */
+    void rate_controller::reset()
+    {
+        rate = std::clamp(setup.initial_rate, setup.minimum_rate, setup.maximum_rate);
+        latency = 0;
+        next_slot = 0;
+        last_decrease = 0;
+    }
+
+    /**
+     * \brief time until the next report may be sent
+     *
+     * @param now monotonic time in ns
+     * @return uint64_t ns to wait, 0 if a slot is free
+     */
+    uint64_t rate_controller::delay(const uint64_t _now) const
+    {
+        return (next_slot > _now) ? next_slot - _now : 0;
+    }
+
+    /**
+     * \brief take a slot for a report
+     */
+    void rate_controller::sent(const uint64_t _now)
+    {
+        next_slot = std::max(next_slot, _now) + static_cast<uint64_t>(NANOSECONDS / rate);
+        ++reports;
+    }
+
+    /**
+     * \brief account a completed report
+     *
+     * @param latency ioctl completion time in ns
+     * @param success ioctl result
+     * @param now monotonic time in ns
+     */
+    void rate_controller::completed(const uint64_t _latency, const bool _success, const uint64_t _now)
+    {
+        /* smoothed latency, 1/8 weight for the new sample */
+        latency = (latency == 0) ? _latency : latency - (latency >> 3) + (_latency >> 3);
+
+        if (!_success)
+        {
+            ++errors;
+        }
+
+        if (!_success || latency > setup.latency_target)
+        {
+            if (_now - last_decrease >= setup.window)
+            {
+                rate = std::max(rate * setup.decrease, setup.minimum_rate);
+                last_decrease = _now;
+                ++decreases;
+            }
+        }
+        else
+        {
+            rate = std::min(rate + setup.increase / rate, setup.maximum_rate);
+        }
+    }
+
+    /**
+     * \brief monotonic time in ns
+     */
+    uint64_t rate_controller::now()
+    {
+        struct timespec value;
+        clock_gettime(CLOCK_MONOTONIC, &value);
+        return static_cast<uint64_t>(value.tv_sec) * NANOSECONDS + value.tv_nsec;
+    }
+
+    /**
+     * \brief sleep for a duration in ns
+     */
+    void rate_controller::wait(const uint64_t _duration)
+    {
+        struct timespec value;
+        value.tv_sec = _duration / NANOSECONDS;
+        value.tv_nsec = _duration % NANOSECONDS;
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &value, nullptr);
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * \file varikey_rate.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_RATE_HPP__
+#define __VARIKEY_RATE_HPP__
+
+#include <cstdint>
+
+namespace varikey
+{
+    /**
+     * \brief adaptive report rate of a gadget
+     *
+     * The allowed report rate follows an AIMD scheme: every report that
+     * completes within the latency target raises the rate by about
+     * "increase" reports/s per second, a failed or slow report cuts it by
+     * the "decrease" factor, at most once per window. Reports beyond the
+     * allowed rate are held or coalesced by the caller.
+     */
+    class rate_controller
+    {
+    public:
+        enum class policy
+        {
+            NONE,     /* send immediately */
+            HOLD,     /* wait for the next slot */
+            COALESCE, /* replace superseded reports, hold the others */
+        };
+
+        struct parameter
+        {
+            double initial_rate;     /* reports/s */
+            double minimum_rate;     /* reports/s */
+            double maximum_rate;     /* reports/s */
+            double increase;         /* reports/s per second */
+            double decrease;         /* multiplicative factor */
+            uint64_t latency_target; /* ns */
+            uint64_t window;         /* ns between two decreases */
+        };
+
+        rate_controller();
+        virtual ~rate_controller() {}
+
+        void configure(const parameter &);
+        void reset();
+
+        uint64_t delay(const uint64_t now) const;
+        void sent(const uint64_t now);
+        void completed(const uint64_t latency, const bool success, const uint64_t now);
+
+        double get_rate() const { return rate; }
+        uint64_t get_latency() const { return latency; }
+        uint64_t get_reports() const { return reports; }
+        uint64_t get_errors() const { return errors; }
+        uint64_t get_decreases() const { return decreases; }
+
+        static uint64_t now();
+        static void wait(const uint64_t duration);
+
+    private:
+        parameter setup;
+
+        double rate;
+        uint64_t latency{0};
+        uint64_t next_slot{0};
+        uint64_t last_decrease{0};
+
+        uint64_t reports{0};
+        uint64_t errors{0};
+        uint64_t decreases{0};
+    };
+}
+
+#endif /* __VARIKEY_RATE_HPP__ */
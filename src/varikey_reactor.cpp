@@ -0,0 +1,789 @@
+/**
+ * \file varikey_reactor.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "varikey_input.hpp"
+#include "varikey_reactor.hpp"
+
+/**
+ * \brief multiplicative hash of a device unique
+ */
+#define REACTOR_HASH(unique) ((unique) * 2654435761U)
+
+/**
+ * \brief epoll keys of the wakeup eventfd and the pacing timer, sources start at 1
+ * @{
+ */
+#define REACTOR_WAKE_KEY 0
+#define REACTOR_PACE_KEY (~0ULL)
+/** }@ */
+
+static void arm(const int handle, const uint64_t due);
+
+namespace varikey
+{
+    reactor::reactor()
+    {
+        epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_handle < 0)
+        {
+            fprintf(stderr, "error creating epoll set: %d %s\n", errno, strerror(errno));
+            return;
+        }
+
+        wake_handle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_handle < 0)
+        {
+            fprintf(stderr, "error creating eventfd: %d %s\n", errno, strerror(errno));
+            return;
+        }
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = REACTOR_WAKE_KEY;
+        epoll_ctl(epoll_handle, EPOLL_CTL_ADD, wake_handle, &event);
+
+        pace_handle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (pace_handle < 0)
+        {
+            fprintf(stderr, "error creating timer: %d %s\n", errno, strerror(errno));
+            return;
+        }
+        event.data.u64 = REACTOR_PACE_KEY;
+        epoll_ctl(epoll_handle, EPOLL_CTL_ADD, pace_handle, &event);
+    }
+
+    reactor::~reactor()
+    {
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            release(i);
+        }
+        if (wake_handle >= 0)
+        {
+            close(wake_handle);
+        }
+        if (pace_handle >= 0)
+        {
+            close(pace_handle);
+        }
+        if (epoll_handle >= 0)
+        {
+            close(epoll_handle);
+        }
+    }
+
+    /**
+     * \brief multiplex input reports and output queue of an open gadget
+     *
+     * @param gadget open gadget, the reactor does not own it
+     * @param input called with every input report
+     * @param lost called after the gadget failed and was detached
+     * @return true if the gadget is registered
+     */
+    bool reactor::attach(gadget::usb &_gadget, input_handler _input, lost_handler _lost)
+    {
+        const int handle = _gadget.get_handle();
+        if (handle < 0 || epoll_handle < 0)
+        {
+            return false;
+        }
+
+        const size_t index = allocate(source_type::DEVICE, handle);
+        source &item = *sources[index];
+        item.gadget = &_gadget;
+        item.input = _input;
+        item.lost = _lost;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = make_key(index, item.generation);
+        if (epoll_ctl(epoll_handle, EPOLL_CTL_ADD, handle, &event) < 0)
+        {
+            fprintf(stderr, "error adding device to epoll set: %d %s\n", errno, strerror(errno));
+            release(index);
+            return false;
+        }
+
+        /* input interfaces share the key, any of them wakes the gadget */
+        item.input_count = 0;
+        for (size_t i = 0; i < _gadget.get_input_count(); ++i)
+        {
+            const int input = _gadget.get_input_handle(i);
+            if (input >= 0 && epoll_ctl(epoll_handle, EPOLL_CTL_ADD, input, &event) == 0)
+            {
+                item.inputs[item.input_count++] = input;
+            }
+        }
+
+        ++devices;
+        return true;
+    }
+
+    /**
+     * \brief stop servicing a gadget, queued reports are dropped
+     */
+    void reactor::detach(gadget::usb &_gadget)
+    {
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            if (sources[i]->type == source_type::DEVICE && sources[i]->gadget == &_gadget)
+            {
+                unregister(*sources[i]);
+                release(i);
+                --devices;
+                return;
+            }
+        }
+    }
+
+    /**
+     * \brief periodic timer
+     *
+     * @param period timer period in ns
+     * @param handler called with the number of expirations since the last call
+     * @return true if the timer is armed
+     */
+    bool reactor::add_timer(const uint64_t _period, timer_handler _handler)
+    {
+        const int handle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (handle < 0)
+        {
+            fprintf(stderr, "error creating timer: %d %s\n", errno, strerror(errno));
+            return false;
+        }
+
+        struct itimerspec setup = {};
+        setup.it_interval.tv_sec = _period / 1000000000ULL;
+        setup.it_interval.tv_nsec = _period % 1000000000ULL;
+        setup.it_value = setup.it_interval;
+        timerfd_settime(handle, 0, &setup, nullptr);
+
+        const size_t index = allocate(source_type::TIMER, handle);
+        sources[index]->timer = _handler;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = make_key(index, sources[index]->generation);
+        if (epoll_ctl(epoll_handle, EPOLL_CTL_ADD, handle, &event) < 0)
+        {
+            release(index);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief one-shot timer re-armed by its handler
+     *
+     * @param due first expiry, absolute CLOCK_MONOTONIC time in ns
+     * @param handler called with the current time, returns the next due
+     * time or 0 to stay disarmed
+     * @return true if the alarm is armed
+     */
+    bool reactor::add_alarm(const uint64_t _due, alarm_handler _handler)
+    {
+        const int handle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (handle < 0)
+        {
+            fprintf(stderr, "error creating timer: %d %s\n", errno, strerror(errno));
+            return false;
+        }
+        arm(handle, _due);
+
+        const size_t index = allocate(source_type::ALARM, handle);
+        sources[index]->alarm = _handler;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = make_key(index, sources[index]->generation);
+        if (epoll_ctl(epoll_handle, EPOLL_CTL_ADD, handle, &event) < 0)
+        {
+            release(index);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief report created and removed device nodes
+     *
+     * a node counts as added on creation and again on an attribute
+     * change, udev sets the permissions after the node appears
+     *
+     * @param directory device directory, usually /dev
+     * @param handler called with the node name
+     * @return true if the directory is watched
+     */
+    bool reactor::watch_hotplug(const char *_directory, hotplug_handler _handler)
+    {
+        const int handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (handle < 0)
+        {
+            fprintf(stderr, "error creating inotify: %d %s\n", errno, strerror(errno));
+            return false;
+        }
+
+        if (inotify_add_watch(handle, _directory, IN_CREATE | IN_DELETE | IN_ATTRIB) < 0)
+        {
+            fprintf(stderr, "error watching %s: %d %s\n", _directory, errno, strerror(errno));
+            close(handle);
+            return false;
+        }
+
+        const size_t index = allocate(source_type::HOTPLUG, handle);
+        sources[index]->hotplug = _handler;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = make_key(index, sources[index]->generation);
+        if (epoll_ctl(epoll_handle, EPOLL_CTL_ADD, handle, &event) < 0)
+        {
+            release(index);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief queue an output report for an attached gadget
+     *
+     * a full queue drops the report
+     *
+     * @return true if the report is queued
+     */
+    bool reactor::post(gadget::usb &_gadget, const command &_command)
+    {
+        {
+            std::lock_guard<std::mutex> table(table_lock);
+            source *item = nullptr;
+            for (auto &i : sources)
+            {
+                if (i->type == source_type::DEVICE && i->gadget == &_gadget)
+                {
+                    item = i.get();
+                    break;
+                }
+            }
+
+            if (item == nullptr)
+            {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> guard(item->lock);
+            if (item->count == VARIKEY_REACTOR_QUEUE)
+            {
+                ++dropped;
+                return false;
+            }
+            item->queue[(item->head + item->count) % VARIKEY_REACTOR_QUEUE] = _command;
+            ++item->count;
+        }
+
+        queued = true;
+        const uint64_t one = 1;
+        if (write(wake_handle, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            fprintf(stderr, "error waking reactor: %d %s\n", errno, strerror(errno));
+        }
+        return true;
+    }
+
+    /**
+     * \brief run a task on the reactor thread, callable from any thread
+     */
+    void reactor::post(task _task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(task_lock);
+            tasks.push_back(std::move(_task));
+        }
+
+        const uint64_t one = 1;
+        if (write(wake_handle, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            fprintf(stderr, "error waking reactor: %d %s\n", errno, strerror(errno));
+        }
+    }
+
+    /**
+     * \brief run the event loop until stop
+     */
+    void reactor::run()
+    {
+        struct epoll_event events[VARIKEY_REACTOR_EVENTS];
+
+        while (!stopping && epoll_handle >= 0)
+        {
+            const int count = epoll_wait(epoll_handle, events, VARIKEY_REACTOR_EVENTS, queued ? 0 : -1);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                fprintf(stderr, "error waiting for events: %d %s\n", errno, strerror(errno));
+                return;
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (events[i].data.u64 == REACTOR_WAKE_KEY)
+                {
+                    uint64_t value;
+                    while (read(wake_handle, &value, sizeof(value)) > 0)
+                    {
+                    }
+                    run_tasks();
+                    continue;
+                }
+                if (events[i].data.u64 == REACTOR_PACE_KEY)
+                {
+                    uint64_t expirations;
+                    (void)!read(pace_handle, &expirations, sizeof(expirations));
+                    pace_due = 0;
+                    queued = true;
+                    continue;
+                }
+
+                /* a stale key belongs to a released source */
+                source *item = lookup(events[i].data.u64);
+                if (item == nullptr)
+                {
+                    continue;
+                }
+
+                switch (item->type)
+                {
+                case source_type::DEVICE:
+                    handle_device(*item, events[i].events);
+                    break;
+                case source_type::TIMER:
+                    handle_timer(*item);
+                    break;
+                case source_type::ALARM:
+                    handle_alarm(*item);
+                    break;
+                case source_type::HOTPLUG:
+                    handle_hotplug(*item);
+                    break;
+                case source_type::NONE:
+                    break;
+                }
+            }
+
+            if (queued)
+            {
+                drain();
+            }
+        }
+    }
+
+    /**
+     * \brief run the posted tasks, tasks posted meanwhile wake the loop again
+     */
+    void reactor::run_tasks()
+    {
+        std::vector<task> pending;
+        {
+            std::lock_guard<std::mutex> guard(task_lock);
+            pending.swap(tasks);
+        }
+
+        for (auto &i : pending)
+        {
+            i();
+        }
+    }
+
+    /**
+     * \brief leave run, callable from any thread
+     */
+    void reactor::stop()
+    {
+        stopping = true;
+        const uint64_t one = 1;
+        if (write(wake_handle, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            fprintf(stderr, "error waking reactor: %d %s\n", errno, strerror(errno));
+        }
+    }
+
+    /**
+     * \brief read all pending input reports of a gadget
+     *
+     * the input handler may detach its own gadget, the release keeps the
+     * running handler and its slot until the call returned
+     */
+    void reactor::handle_device(source &_source, const uint32_t _events)
+    {
+        gadget::usb &device = *_source.gadget;
+        uint8_t report[VARIKEY_INPUT_REPORT_SIZE];
+
+        for (;;)
+        {
+            const int length = device.read_input(report, sizeof(report), 0);
+            if (length <= 0)
+            {
+                if (length < 0 || (_events & (EPOLLERR | EPOLLHUP)))
+                {
+                    lose(_source);
+                }
+                return;
+            }
+
+            ++reports;
+            if (!_source.input)
+            {
+                continue;
+            }
+
+            const uint32_t generation = _source.generation;
+            _source.dispatching = true;
+            _source.input(device, report, length);
+            _source.dispatching = false;
+            if (_source.generation != generation)
+            {
+                /* the handler detached the gadget, drop the handlers kept for the call */
+                _source.input = nullptr;
+                _source.lost = nullptr;
+                return;
+            }
+        }
+    }
+
+    void reactor::handle_timer(source &_source)
+    {
+        uint64_t expirations = 0;
+        if (read(_source.handle, &expirations, sizeof(expirations)) == sizeof(expirations) && _source.timer)
+        {
+            _source.timer(expirations);
+        }
+    }
+
+    void reactor::handle_alarm(source &_source)
+    {
+        uint64_t expirations = 0;
+        if (read(_source.handle, &expirations, sizeof(expirations)) == sizeof(expirations) && _source.alarm)
+        {
+            arm(_source.handle, _source.alarm(rate_controller::now()));
+        }
+    }
+
+    void reactor::handle_hotplug(source &_source)
+    {
+        alignas(struct inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(_source.handle, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *position = buffer; position < buffer + length;)
+            {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(position);
+                position += sizeof(struct inotify_event) + event->len;
+
+                if (event->len > 0 && _source.hotplug)
+                {
+                    _source.hotplug(event->name, (event->mask & IN_DELETE) == 0);
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief send queued output reports, a few per gadget and round
+     *
+     * the bounded burst keeps one busy gadget from starving the others; a
+     * gadget without a free rate slot keeps its reports and is served
+     * again by the pacing timer, the reactor thread never sleeps on it
+     */
+    void reactor::drain()
+    {
+        queued = false;
+        uint64_t next = 0;
+
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            source &item = *sources[i];
+            if (item.type != source_type::DEVICE)
+            {
+                continue;
+            }
+
+            gadget::usb &device = *item.gadget;
+            const uint64_t timeout = (device.get_timeout() != 0) ? device.get_timeout() : VARIKEY_REACTOR_DEADLINE;
+            bool remaining = false;
+            for (size_t j = 0; j < VARIKEY_REACTOR_BURST && item.type == source_type::DEVICE; ++j)
+            {
+                const uint64_t now = rate_controller::now();
+                const uint64_t delay = device.get_send_delay(now);
+
+                command report;
+                {
+                    std::lock_guard<std::mutex> guard(item.lock);
+                    if (item.count == 0)
+                    {
+                        break;
+                    }
+                    if (delay > 0)
+                    {
+                        next = (next == 0) ? now + delay : std::min(next, now + delay);
+                        break;
+                    }
+                    report = item.queue[item.head];
+                    item.head = (item.head + 1) % VARIKEY_REACTOR_QUEUE;
+                    --item.count;
+                    remaining = (item.count > 0);
+                }
+
+                const gadget::status result = device.send_command(report, now + timeout);
+                if (result == gadget::status::FAILURE || result == gadget::status::CLOSED)
+                {
+                    lose(item);
+                    break;
+                }
+                if (result != gadget::status::SUCCESS)
+                {
+                    /* timed out or the previous call still runs */
+                    ++dropped;
+                    break;
+                }
+                ++sent;
+            }
+
+            if (remaining && item.type == source_type::DEVICE)
+            {
+                const uint64_t now = rate_controller::now();
+                const uint64_t delay = device.get_send_delay(now);
+                if (delay == 0)
+                {
+                    queued = true;
+                }
+                else
+                {
+                    next = (next == 0) ? now + delay : std::min(next, now + delay);
+                }
+            }
+        }
+
+        if (next != 0)
+        {
+            pace(next);
+        }
+    }
+
+    /**
+     * \brief arm the pacing timer for the earliest waiting gadget
+     */
+    void reactor::pace(const uint64_t _due)
+    {
+        if (pace_handle < 0 || (pace_due != 0 && pace_due <= _due))
+        {
+            return;
+        }
+
+        arm(pace_handle, _due);
+        pace_due = _due;
+    }
+
+    /**
+     * \brief detach a failed gadget and tell its owner
+     */
+    void reactor::lose(source &_source)
+    {
+        gadget::usb &device = *_source.gadget;
+        lost_handler lost = _source.lost;
+
+        /* deregister before the handle numbers can be reused */
+        unregister(_source);
+        if (device.is_open())
+        {
+            device.usb_close();
+        }
+
+        detach(device);
+        if (lost)
+        {
+            lost(device);
+        }
+    }
+
+    /**
+     * \brief remove the handles of a gadget from the epoll set
+     *
+     * a closed input interface left the set with its close, its number
+     * may belong to another handle by now
+     */
+    void reactor::unregister(source &_source)
+    {
+        epoll_ctl(epoll_handle, EPOLL_CTL_DEL, _source.handle, nullptr);
+        for (size_t i = 0; i < _source.input_count; ++i)
+        {
+            for (size_t j = 0; j < _source.gadget->get_input_count(); ++j)
+            {
+                if (_source.gadget->get_input_handle(j) == _source.inputs[i])
+                {
+                    epoll_ctl(epoll_handle, EPOLL_CTL_DEL, _source.inputs[i], nullptr);
+                }
+            }
+        }
+        _source.input_count = 0;
+    }
+
+    size_t reactor::allocate(const source_type _type, const int _handle)
+    {
+        std::lock_guard<std::mutex> table(table_lock);
+
+        size_t index = 0;
+        while (index < sources.size() && (sources[index]->type != source_type::NONE || sources[index]->dispatching))
+        {
+            ++index;
+        }
+        if (index == sources.size())
+        {
+            sources.emplace_back(new source());
+        }
+
+        source &item = *sources[index];
+        item.type = _type;
+        item.handle = _handle;
+        item.head = 0;
+        item.count = 0;
+        return index;
+    }
+
+    void reactor::release(const size_t _index)
+    {
+        std::lock_guard<std::mutex> table(table_lock);
+
+        source &item = *sources[_index];
+        if (item.type == source_type::TIMER || item.type == source_type::ALARM || item.type == source_type::HOTPLUG)
+        {
+            close(item.handle);
+        }
+
+        item.type = source_type::NONE;
+        ++item.generation;
+        item.handle = -1;
+        item.gadget = nullptr;
+        if (!item.dispatching)
+        {
+            item.input = nullptr;
+            item.lost = nullptr;
+        }
+        item.timer = nullptr;
+        item.alarm = nullptr;
+        item.hotplug = nullptr;
+
+        std::lock_guard<std::mutex> guard(item.lock);
+        item.count = 0;
+    }
+
+    reactor::source *reactor::lookup(const uint64_t _key)
+    {
+        const size_t index = (_key & 0xffffffffULL) - 1;
+        if (index >= sources.size())
+        {
+            return nullptr;
+        }
+
+        source *item = sources[index].get();
+        return (item->generation == (_key >> 32) && item->type != source_type::NONE) ? item : nullptr;
+    }
+
+    uint64_t reactor::make_key(const size_t _index, const uint32_t _generation)
+    {
+        return (static_cast<uint64_t>(_generation) << 32) | (_index + 1);
+    }
+
+    /**
+     * \brief create the reactors
+     *
+     * @param count number of reactors, 0 for one per core
+     */
+    reactor_pool::reactor_pool(const size_t _count)
+    {
+        size_t count = _count;
+        if (count == 0)
+        {
+            count = std::max(1U, std::thread::hardware_concurrency());
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            reactors.emplace_back(new reactor());
+        }
+    }
+
+    reactor_pool::~reactor_pool()
+    {
+        stop();
+    }
+
+    /**
+     * \brief reactor serving a gadget, stable for a unique identifier
+     */
+    reactor &reactor_pool::shard(const uint32_t _unique)
+    {
+        return *reactors[REACTOR_HASH(_unique) % reactors.size()];
+    }
+
+    /**
+     * \brief run every reactor on its own thread pinned to its own core
+     */
+    void reactor_pool::start()
+    {
+        const unsigned int cores = std::max(1U, std::thread::hardware_concurrency());
+
+        for (size_t i = 0; i < reactors.size(); ++i)
+        {
+            threads.emplace_back(&reactor::run, reactors[i].get());
+
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % cores, &cpus);
+            pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+
+    void reactor_pool::stop()
+    {
+        for (auto &i : reactors)
+        {
+            i->stop();
+        }
+        for (auto &i : threads)
+        {
+            i.join();
+        }
+        threads.clear();
+    }
+}
+
+/**
+ * \brief arm a one-shot timerfd at an absolute CLOCK_MONOTONIC time
+ *
+ * a due time in the past expires at once, 0 disarms
+ */
+static void arm(const int _handle, const uint64_t _due)
+{
+    struct itimerspec setup = {};
+    setup.it_value.tv_sec = _due / 1000000000ULL;
+    setup.it_value.tv_nsec = _due % 1000000000ULL;
+    timerfd_settime(_handle, TFD_TIMER_ABSTIME, &setup, nullptr);
+}
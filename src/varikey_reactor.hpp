@@ -0,0 +1,169 @@
+/**
+ * \file varikey_reactor.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_REACTOR_HPP__
+#define __VARIKEY_REACTOR_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "varikey_command.hpp"
+#include "varikey_gadget_usb.hpp"
+
+/**
+ * \brief reactor limits
+ * @{
+ */
+#define VARIKEY_REACTOR_QUEUE 16  /* queued output reports per device */
+#define VARIKEY_REACTOR_EVENTS 64 /* epoll events per wakeup */
+#define VARIKEY_REACTOR_BURST 4   /* output reports per device and wakeup */
+#define VARIKEY_REACTOR_DEADLINE 20000000ULL /* ns per output report without gadget timeout */
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief single threaded event loop for many gadgets
+     *
+     * One epoll set multiplexes the input reports of all attached gadgets
+     * from their control and input interfaces, their output queues, periodic timers (timerfd) and hotplug events
+     * (inotify on the device directory). Handlers run on the reactor
+     * thread and may use their gadget directly; other threads hand output
+     * reports or tasks over with post(). Queued reports never wait for a rate slot
+     * on the reactor thread, a gadget without a free slot is served again
+     * by a pacing timer, and every report has a deadline.
+     *
+     * attach, add_timer, add_alarm and watch_hotplug are called before
+     * run or from a handler or task, post and stop from any thread.
+     */
+    class reactor
+    {
+    public:
+        using input_handler = std::function<void(gadget::usb &, const uint8_t *report, const size_t length)>;
+        using lost_handler = std::function<void(gadget::usb &)>;
+        using timer_handler = std::function<void(const uint64_t expirations)>;
+        using alarm_handler = std::function<uint64_t(const uint64_t now)>;
+        using hotplug_handler = std::function<void(const char *name, const bool added)>;
+        using task = std::function<void()>;
+
+        reactor();
+        virtual ~reactor();
+
+        bool attach(gadget::usb &, input_handler, lost_handler = nullptr);
+        void detach(gadget::usb &);
+        bool add_timer(const uint64_t period, timer_handler);
+        bool add_alarm(const uint64_t due, alarm_handler);
+        bool watch_hotplug(const char *directory, hotplug_handler);
+
+        bool post(gadget::usb &, const command &);
+        void post(task);
+
+        void run();
+        void stop();
+
+        size_t get_device_count() const { return devices; }
+        uint64_t get_reports() const { return reports; }
+        uint64_t get_sent() const { return sent; }
+        uint64_t get_dropped() const { return dropped; }
+
+    private:
+        enum class source_type : uint8_t
+        {
+            NONE,
+            DEVICE,
+            TIMER,
+            ALARM,
+            HOTPLUG,
+        };
+
+        struct source
+        {
+            source_type type{source_type::NONE};
+            uint32_t generation{0};
+            int handle{-1};
+
+            gadget::usb *gadget{nullptr};
+            int inputs[VARIKEY_INPUT_LIMIT]; /* registered input interfaces of the gadget */
+            size_t input_count{0};
+            input_handler input;
+            lost_handler lost;
+            timer_handler timer;
+            alarm_handler alarm;
+            hotplug_handler hotplug;
+            bool dispatching{false}; /* input handler running, release keeps it */
+
+            /* output queue, filled by post, drained on the reactor thread */
+            std::mutex lock;
+            command queue[VARIKEY_REACTOR_QUEUE];
+            size_t head{0};
+            size_t count{0};
+        };
+
+        size_t allocate(const source_type, const int handle);
+        void release(const size_t index);
+        source *lookup(const uint64_t key);
+        static uint64_t make_key(const size_t index, const uint32_t generation);
+
+        void handle_device(source &, const uint32_t events);
+        void handle_timer(source &);
+        void handle_alarm(source &);
+        void handle_hotplug(source &);
+        void drain();
+        void run_tasks();
+        void lose(source &);
+        void unregister(source &);
+
+        void pace(const uint64_t due);
+
+        int epoll_handle{-1};
+        int wake_handle{-1};
+        int pace_handle{-1};
+        uint64_t pace_due{0}; /* armed pacing timer, 0 disarmed */
+        std::atomic<bool> stopping{false};
+        std::atomic<bool> queued{false};
+
+        std::mutex task_lock; /* tasks posted from other threads */
+        std::vector<task> tasks;
+
+        std::mutex table_lock; /* sources, written on the reactor thread only */
+        std::vector<std::unique_ptr<source>> sources;
+        size_t devices{0};
+
+        uint64_t reports{0};
+        uint64_t sent{0};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    /**
+     * \brief one reactor per core, gadgets sharded by unique identifier
+     */
+    class reactor_pool
+    {
+    public:
+        explicit reactor_pool(const size_t count);
+        virtual ~reactor_pool();
+
+        reactor &shard(const uint32_t unique);
+        reactor &at(const size_t index) { return *reactors[index]; }
+        size_t size() const { return reactors.size(); }
+
+        void start();
+        void stop();
+
+    private:
+        std::vector<std::unique_ptr<reactor>> reactors;
+        std::vector<std::thread> threads;
+    };
+}
+
+#endif /* __VARIKEY_REACTOR_HPP__ */
@@ -0,0 +1,171 @@
+/**
+ * \file varikey_snapshot.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cstring>
+
+#include "varikey_snapshot.hpp"
+
+namespace varikey
+{
+    snapshot::snapshot()
+    {
+        clear();
+    }
+
+    void snapshot::clear()
+    {
+        memset(spans, 0, sizeof(spans));
+        memset(&icon, 0, sizeof(icon));
+        memset(&backlight, 0, sizeof(backlight));
+        line = 0;
+        column = 0;
+        font_size = 0xff;
+        sequence = 0;
+    }
+
+    /**
+     * \brief track an output report sent to the gadget
+     *
+     * a reset does not clear the snapshot, it is what gets restored
+     */
+    void snapshot::apply(const command &_cmd)
+    {
+        if (_cmd.report != static_cast<uint8_t>(report_id::CUSTOM))
+        {
+            return;
+        }
+
+        switch (static_cast<command_id>(_cmd.command))
+        {
+        case command_id::POSITION:
+            line = _cmd.payload.position.line;
+            column = _cmd.payload.position.column;
+            break;
+        case command_id::FONT_SIZE:
+            font_size = _cmd.payload.byte_value;
+            break;
+        case command_id::TEXT:
+            if (line < VARIKEY_SNAPSHOT_LINES)
+            {
+                /* the text at the same column, else a free or the oldest span */
+                span_state *target = &spans[line][0];
+                for (auto &i : spans[line])
+                {
+                    if (i.order != 0 && i.column == column)
+                    {
+                        target = &i;
+                        break;
+                    }
+                    if (i.order < target->order)
+                    {
+                        target = &i;
+                    }
+                }
+                target->order = ++sequence;
+                target->column = column;
+                target->font_size = font_size;
+                memcpy(target->text, _cmd.payload.text, sizeof(target->text) - 1);
+                target->text[sizeof(target->text) - 1] = '\0';
+            }
+            break;
+        case command_id::ICON:
+            icon.order = ++sequence;
+            icon.value = _cmd.payload.byte_value;
+            break;
+        case command_id::BACKLIGHT:
+            backlight.valid = true;
+            backlight.report = _cmd;
+            ++sequence;
+            break;
+        case command_id::COMPOUND:
+        {
+            command commands[VARIKEY_COMPOUND_LIMIT];
+            const size_t count = decode_compound(_cmd, commands, VARIKEY_COMPOUND_LIMIT);
+            for (size_t i = 0; i < count; ++i)
+            {
+                apply(commands[i]);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    /**
+     * \brief build the command sequence that rebuilds the gadget state
+     *
+     * @param commands command buffer, VARIKEY_SNAPSHOT_COMMANDS fit always
+     * @param capacity command buffer size
+     * @return size_t number of commands
+     */
+    size_t snapshot::restore(command *_commands, const size_t _capacity) const
+    {
+        size_t count = 0;
+        auto emit = [&](const command &cmd)
+        {
+            if (count < _capacity)
+            {
+                _commands[count++] = cmd;
+            }
+        };
+
+        if (backlight.valid)
+        {
+            emit(backlight.report);
+        }
+
+        /* replay texts and icon in drawing order */
+        uint8_t current_font = 0xff;
+        uint32_t last = 0;
+        for (;;)
+        {
+            int next = -1;
+            const span_state *source = nullptr;
+            uint32_t order = UINT32_MAX;
+            for (int i = 0; i < VARIKEY_SNAPSHOT_LINES; ++i)
+            {
+                for (auto &j : spans[i])
+                {
+                    if (j.order > last && j.order < order)
+                    {
+                        next = i;
+                        source = &j;
+                        order = j.order;
+                    }
+                }
+            }
+            if (icon.order > last && icon.order < order)
+            {
+                next = VARIKEY_SNAPSHOT_LINES;
+                order = icon.order;
+            }
+            if (next < 0)
+            {
+                break;
+            }
+            last = order;
+
+            if (next == VARIKEY_SNAPSHOT_LINES)
+            {
+                emit(encode_icon(icon.value));
+                continue;
+            }
+
+            if (source->font_size != 0xff && source->font_size != current_font)
+            {
+                emit(encode_font_size(source->font_size));
+                current_font = source->font_size;
+            }
+            emit(encode_position(next, source->column));
+            emit(encode_text(source->text));
+        }
+
+        return count;
+    }
+}
@@ -0,0 +1,76 @@
+/**
+ * \file varikey_snapshot.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_SNAPSHOT_HPP__
+#define __VARIKEY_SNAPSHOT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "varikey_command.hpp"
+
+#define VARIKEY_SNAPSHOT_LINES 4
+#define VARIKEY_SNAPSHOT_SPANS 4 /* texts per line at distinct columns, the oldest is dropped */
+#define VARIKEY_SNAPSHOT_COMMANDS (1 + 1 + 3 * VARIKEY_SNAPSHOT_LINES * VARIKEY_SNAPSHOT_SPANS)
+
+namespace varikey
+{
+    /**
+     * \brief last applied display and backlight state of a gadget
+     *
+     * Every sent output report updates the snapshot. After a reset or a
+     * replug the snapshot is turned into the shortest ordered command
+     * sequence that rebuilds the screen: backlight first, then texts and
+     * icon in the order they were drawn, a font report only where the
+     * font changes. Texts are kept per line and start column, so several
+     * fields on one line survive, and a partial redraw replays over the
+     * text it updated.
+     */
+    class snapshot
+    {
+    public:
+        snapshot();
+        virtual ~snapshot() {}
+
+        void apply(const command &);
+        void clear();
+
+        bool is_empty() const { return sequence == 0; }
+        size_t restore(command *commands, const size_t capacity) const;
+
+    private:
+        struct span_state
+        {
+            uint32_t order; /* 0 if never drawn */
+            uint8_t column;
+            uint8_t font_size;
+            char text[VARIKEY_TEXT_SIZE];
+        };
+
+        span_state spans[VARIKEY_SNAPSHOT_LINES][VARIKEY_SNAPSHOT_SPANS];
+
+        struct
+        {
+            uint32_t order;
+            uint8_t value;
+        } icon;
+
+        struct
+        {
+            bool valid;
+            command report;
+        } backlight;
+
+        uint8_t line{0};
+        uint8_t column{0};
+        uint8_t font_size{0xff};
+        uint32_t sequence{0};
+    };
+}
+
+#endif /* __VARIKEY_SNAPSHOT_HPP__ */
@@ -0,0 +1,207 @@
+/**
+ * \file varikey_ticker.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "varikey_ticker.hpp"
+
+/**
+ * \brief glyph width in pixels per font size
+ *
+ * assumed fixed pitch fonts, sizes beyond the table use the last entry
+ */
+static const uint8_t TICKER_GLYPH_WIDTH[] = {6, 8, 12, 16};
+
+namespace varikey
+{
+    /**
+     * \brief add a ticker and precompute its frames
+     *
+     * text fitting the window is shown once and never scrolls
+     *
+     * @param setup window and speed
+     * @param text shown text, longer text is cut
+     * @return false if there is no free ticker or the window is empty
+     */
+    bool ticker::add(const setup &_setup, const char *_text)
+    {
+        if (count == VARIKEY_TICKER_LIMIT)
+        {
+            return false;
+        }
+
+        lane &item = lanes[count];
+        item.parameter = _setup;
+
+        const size_t glyph = glyph_width(_setup.font_size);
+        size_t width = (_setup.column < VARIKEY_DISPLAY_WIDTH) ? (VARIKEY_DISPLAY_WIDTH - _setup.column) / glyph : 0;
+        if (_setup.width > 0)
+        {
+            width = std::min<size_t>(width, _setup.width);
+        }
+        width = std::min<size_t>(width, VARIKEY_TEXT_SIZE - 1);
+        if (width == 0)
+        {
+            return false;
+        }
+        item.width = width;
+
+        const size_t length = strnlen(_text, VARIKEY_TICKER_TEXT);
+        if (length <= width)
+        {
+            /* static text, blank padded to clear the window */
+            memset(item.buffer, ' ', width);
+            memcpy(item.buffer, _text, length);
+            item.cycle = 0;
+        }
+        else
+        {
+            /* text, gap, then the start again: every window is contiguous */
+            item.cycle = length + VARIKEY_TICKER_GAP;
+            memcpy(item.buffer, _text, length);
+            memset(item.buffer + length, ' ', VARIKEY_TICKER_GAP);
+            memcpy(item.buffer + item.cycle, item.buffer, width);
+
+            for (size_t step = 0; step < item.cycle; ++step)
+            {
+                const char *current = item.buffer + step;
+                const char *previous = item.buffer + ((step + item.cycle - 1) % item.cycle);
+
+                size_t first = 0;
+                while (first < width && current[first] == previous[first])
+                {
+                    ++first;
+                }
+                size_t last = width;
+                while (last > first && current[last - 1] == previous[last - 1])
+                {
+                    --last;
+                }
+                item.change[step] = {static_cast<uint8_t>(first), static_cast<uint8_t>(last - first)};
+            }
+        }
+
+        item.position = 0;
+        item.due = 0;
+        item.shown = false;
+        ++count;
+        return true;
+    }
+
+    /**
+     * \brief send the frames due at now
+     *
+     * a ticker that fell behind jumps to its current frame and redraws
+     * the whole window once
+     *
+     * @param gadget open gadget
+     * @param now CLOCK_MONOTONIC time in ns
+     * @return size_t number of drawn frames
+     */
+    size_t ticker::tick(gadget::usb &_gadget, const uint64_t _now)
+    {
+        size_t drawn = 0;
+        for (size_t i = 0; i < count && _gadget.is_open(); ++i)
+        {
+            lane &item = lanes[i];
+
+            if (!item.shown)
+            {
+                item.due = _now + item.parameter.step;
+                item.shown = (show(_gadget, item, 0, item.width) == gadget::status::SUCCESS);
+                drawn += item.shown ? 1 : 0;
+                continue;
+            }
+
+            if (item.cycle == 0 || _now < item.due)
+            {
+                continue;
+            }
+
+            const uint64_t steps = (item.parameter.step > 0) ? (_now - item.due) / item.parameter.step + 1 : 1;
+            item.position = (item.position + steps) % item.cycle;
+            item.due += steps * item.parameter.step;
+
+            const span change = (steps == 1) ? item.change[item.position] : span{0, static_cast<uint8_t>(item.width)};
+            if (change.length > 0)
+            {
+                /* a lost diff leaves the window unknown, redraw it whole */
+                item.shown = (show(_gadget, item, change.first, change.length) == gadget::status::SUCCESS);
+                drawn += item.shown ? 1 : 0;
+            }
+        }
+        return drawn;
+    }
+
+    /**
+     * \brief redraw all tickers with the next tick
+     *
+     * used after a reset or reconnect, the gadget lost the shown text
+     */
+    void ticker::invalidate()
+    {
+        font_size = 0xff;
+        for (size_t i = 0; i < count; ++i)
+        {
+            lanes[i].shown = false;
+        }
+    }
+
+    /**
+     * \brief timer period serving all tickers, the fastest step
+     */
+    uint64_t ticker::get_period() const
+    {
+        uint64_t period = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (lanes[i].cycle > 0 && (period == 0 || lanes[i].parameter.step < period))
+            {
+                period = lanes[i].parameter.step;
+            }
+        }
+        return period;
+    }
+
+    /**
+     * \brief glyph width of a font size in pixels
+     */
+    uint8_t ticker::glyph_width(const uint8_t _font_size)
+    {
+        const size_t sizes = sizeof(TICKER_GLYPH_WIDTH) / sizeof(TICKER_GLYPH_WIDTH[0]);
+        return TICKER_GLYPH_WIDTH[std::min<size_t>(_font_size, sizes - 1)];
+    }
+
+    /**
+     * \brief draw a part of the current window
+     */
+    gadget::status ticker::show(gadget::usb &_gadget, lane &_lane, const size_t _first, const size_t _length)
+    {
+        command commands[3];
+        size_t count = 0;
+        if (font_size != _lane.parameter.font_size)
+        {
+            commands[count++] = encode_font_size(_lane.parameter.font_size);
+        }
+
+        const size_t column = _lane.parameter.column + _first * glyph_width(_lane.parameter.font_size);
+        commands[count++] = encode_position(_lane.parameter.line, static_cast<int>(column));
+        commands[count++] = encode_text(std::string_view(_lane.buffer + _lane.position + _first, _length));
+
+        /* one compound report where the firmware decodes them */
+        const gadget::status result = _gadget.send_commands(commands, count);
+        if (result == gadget::status::SUCCESS)
+        {
+            font_size = _lane.parameter.font_size;
+            ++frames;
+            characters += _length;
+        }
+        return result;
+    }
+}
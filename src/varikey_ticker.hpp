@@ -0,0 +1,99 @@
+/**
+ * \file varikey_ticker.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_TICKER_HPP__
+#define __VARIKEY_TICKER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "varikey_command.hpp"
+#include "varikey_gadget_usb.hpp"
+
+/**
+ * \brief ticker limits and display geometry
+ * @{
+ */
+#define VARIKEY_TICKER_LIMIT 4    /* tickers per device */
+#define VARIKEY_TICKER_TEXT 128   /* longest scrolled text */
+#define VARIKEY_TICKER_GAP 3      /* blanks between the end and the next start */
+#define VARIKEY_DISPLAY_WIDTH 128 /* display width in pixels */
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief marquee for text longer than a display line
+     *
+     * Every ticker scrolls its text through a window of a display line
+     * one character per step. All windows of a cycle are views into one
+     * doubled text buffer and the span that differs from the previous
+     * frame is computed on add, so a frame is a table lookup and sends
+     * only the changed characters. Tickers run independently, each at
+     * its own speed, and share the device font by switching it only
+     * when the next frame needs another size.
+     */
+    class ticker
+    {
+    public:
+        struct setup
+        {
+            uint8_t line;
+            uint8_t column;    /* pixel column of the window */
+            uint8_t font_size;
+            uint8_t width;     /* window in characters, 0 up to the display edge */
+            uint64_t step;     /* ns per character */
+        };
+
+        ticker() {}
+        virtual ~ticker() {}
+
+        bool add(const setup &, const char *text);
+        void clear() { count = 0; }
+        size_t size() const { return count; }
+
+        size_t tick(gadget::usb &, const uint64_t now);
+        void invalidate();
+        uint64_t get_period() const;
+
+        uint64_t get_frames() const { return frames; }
+        uint64_t get_characters() const { return characters; }
+
+        static uint8_t glyph_width(const uint8_t font_size);
+
+    private:
+        struct span
+        {
+            uint8_t first;
+            uint8_t length;
+        };
+
+        struct lane
+        {
+            setup parameter;
+            char buffer[2 * (VARIKEY_TICKER_TEXT + VARIKEY_TICKER_GAP)];
+            span change[VARIKEY_TICKER_TEXT + VARIKEY_TICKER_GAP];
+            size_t cycle;   /* steps until the text repeats, 0 for static text */
+            size_t width;   /* window in characters */
+            size_t position;
+            uint64_t due;
+            bool shown;
+        };
+
+        gadget::status show(gadget::usb &, lane &, const size_t first, const size_t length);
+
+        lane lanes[VARIKEY_TICKER_LIMIT];
+        size_t count{0};
+        uint8_t font_size{0xff};
+
+        uint64_t frames{0};
+        uint64_t characters{0};
+    };
+}
+
+#endif /* __VARIKEY_TICKER_HPP__ */
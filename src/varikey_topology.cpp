@@ -0,0 +1,111 @@
+/**
+ * \file varikey_topology.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <linux/hid.h>
+#include <linux/input.h>
+
+#include "varikey_descriptor.hpp"
+#include "varikey_topology.hpp"
+
+static ssize_t read_file(const char *path, void *buffer, const size_t size);
+
+namespace varikey
+{
+    namespace topology
+    {
+        /**
+         * \brief locate a hidraw node without opening it
+         *
+         * the node link points to the hid device directory
+         * BUS:VENDOR:PRODUCT.INSTANCE below its usb interface directory
+         * PORT:CONFIGURATION.INTERFACE, the report descriptor there is the
+         * kernel copy, the device is not involved
+         *
+         * @param device_path node path, only the node name is used
+         * @param location filled on success
+         * @param sysfs hidraw class directory
+         * @return false if the node has no sysfs entry, e.g. not a hidraw node
+         */
+        bool locate(const char *_device_path, location &_location, const char *_sysfs)
+        {
+            memset(&_location, 0, sizeof(_location));
+
+            const char *node = strrchr(_device_path, '/');
+            node = (node != nullptr) ? node + 1 : _device_path;
+
+            char path[PATH_MAX + 32]; /* room for the attribute names */
+            snprintf(path, sizeof(path), "%s/%s/device", _sysfs, node);
+            char device[PATH_MAX];
+            if (realpath(path, device) == nullptr)
+            {
+                return false;
+            }
+
+            char *name = strrchr(device, '/');
+            unsigned int bus = 0, vendor = 0, product = 0;
+            if (name == nullptr || sscanf(name + 1, "%x:%x:%x", &bus, &vendor, &product) != 3)
+            {
+                return false;
+            }
+            _location.vendor = static_cast<uint16_t>(vendor);
+            _location.product = static_cast<uint16_t>(product);
+
+            uint8_t data[HID_MAX_DESCRIPTOR_SIZE];
+            snprintf(path, sizeof(path), "%s/report_descriptor", device);
+            const ssize_t size = read_file(path, data, sizeof(data));
+            report_descriptor layout;
+            if (size <= 0 || !layout.parse(data, size))
+            {
+                return false;
+            }
+            const auto &fields = layout.get_fields();
+            _location.control = std::any_of(fields.begin(), fields.end(), [](const report_descriptor::field &i)
+                                            { return i.kind == report_descriptor::type::FEATURE; });
+
+            *name = '\0';
+            const char *parent = strrchr(device, '/');
+            const char *separator = (parent != nullptr) ? strchr(parent, ':') : nullptr;
+            if (bus != BUS_USB || separator == nullptr)
+            {
+                return true;
+            }
+
+            const size_t length = std::min<size_t>(separator - parent - 1, sizeof(_location.port) - 1);
+            memcpy(_location.port, parent + 1, length);
+            _location.port[length] = '\0';
+
+            char number[8] = {};
+            snprintf(path, sizeof(path), "%s/bInterfaceNumber", device);
+            if (read_file(path, number, sizeof(number) - 1) > 0)
+            {
+                _location.interface = static_cast<uint8_t>(strtoul(number, nullptr, 16));
+            }
+            return true;
+        }
+    }
+}
+
+static ssize_t read_file(const char *_path, void *_buffer, const size_t _size)
+{
+    const int handle = open(_path, O_RDONLY | O_CLOEXEC);
+    if (handle < 0)
+    {
+        return -1;
+    }
+    const ssize_t length = read(handle, _buffer, _size);
+    close(handle);
+    return length;
+}
@@ -0,0 +1,46 @@
+/**
+ * \file varikey_topology.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_TOPOLOGY_HPP__
+#define __VARIKEY_TOPOLOGY_HPP__
+
+#include <cstdint>
+
+/**
+ * \brief sysfs location of hidraw nodes
+ * @{
+ */
+#define VARIKEY_SYSFS_HIDRAW "/sys/class/hidraw"
+#define VARIKEY_PORT_SIZE 32 /* usb bus and port path, "1-2.3" */
+/** }@ */
+
+namespace varikey
+{
+    namespace topology
+    {
+        /**
+         * \brief physical position of a hidraw node
+         *
+         * All interfaces of a composite gadget share the port path and
+         * differ in the interface number. Only the interface with feature
+         * reports in its report descriptor answers the identity requests.
+         */
+        struct location
+        {
+            char port[VARIKEY_PORT_SIZE]; /* empty for devices outside usb */
+            uint8_t interface;
+            uint16_t vendor;
+            uint16_t product;
+            bool control; /* interface with feature reports */
+        };
+
+        bool locate(const char *device_path, location &, const char *sysfs = VARIKEY_SYSFS_HIDRAW);
+    }
+}
+
+#endif /* __VARIKEY_TOPOLOGY_HPP__ */
@@ -0,0 +1,256 @@
+/**
+ * \file varikey_trace.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cstdio>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef VARIKEY_TRACING_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/**
+ * \brief USDT semaphore of varikey:span, raised by an attached tracer
+ */
+__extension__ unsigned short varikey_span_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+#define VARIKEY_SPAN_ENABLED() __builtin_expect(varikey_span_semaphore, 0)
+#endif
+
+#include "varikey_rate.hpp"
+#include "varikey_trace.hpp"
+
+struct trace_event
+{
+    const char *name;
+    uint32_t unique;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * \brief span ring of one thread, written by that thread only
+ */
+struct trace_buffer
+{
+    long thread;
+    std::atomic<uint64_t> head{0};
+    trace_event events[VARIKEY_TRACE_EVENTS];
+};
+
+/**
+ * \brief hands the buffer of an exiting thread to the next new thread
+ */
+struct trace_owner
+{
+    trace_buffer *buffer{nullptr};
+    ~trace_owner();
+};
+
+static std::mutex &registry_lock();
+static std::vector<trace_buffer *> &registry();
+static std::vector<trace_buffer *> &released();
+static trace_buffer *local_buffer();
+
+namespace varikey
+{
+    namespace trace
+    {
+        std::atomic<bool> active{false};
+
+        bool enabled()
+        {
+#ifdef VARIKEY_TRACING
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * \brief record spans from now on, no-op without VARIKEY_TRACING
+         */
+        void start()
+        {
+            active = enabled();
+        }
+
+        void stop()
+        {
+            active = false;
+        }
+
+        uint64_t now()
+        {
+            return rate_controller::now();
+        }
+
+        /**
+         * \brief a tracer is attached to the USDT probe
+         */
+        bool probed()
+        {
+#ifdef VARIKEY_TRACING_USDT
+            return VARIKEY_SPAN_ENABLED();
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * \brief close a span begun at begin, fire the probe and record it
+         * when tracing is started
+         */
+        void record(const char *_name, const uint32_t _unique, const uint64_t _begin)
+        {
+            const uint64_t end = now();
+#ifdef VARIKEY_TRACING_USDT
+            if (VARIKEY_SPAN_ENABLED())
+            {
+                DTRACE_PROBE4(varikey, span, _name, _unique, _begin, end);
+            }
+#endif
+
+            if (!active.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            trace_buffer *buffer = local_buffer();
+            if (buffer == nullptr)
+            {
+                return;
+            }
+            const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+            buffer->events[head & (VARIKEY_TRACE_EVENTS - 1)] = {_name, _unique, _begin, end};
+            buffer->head.store(head + 1, std::memory_order_release);
+        }
+
+        /**
+         * \brief write all recorded spans as Chrome trace JSON
+         *
+         * spans recorded while writing may be torn, write after the
+         * traced work has stopped
+         *
+         * @param path output file
+         * @return false if tracing is not built in or the file fails
+         */
+        bool write(const char *_path)
+        {
+            if (!enabled())
+            {
+                return false;
+            }
+
+            FILE *output = fopen(_path, "w");
+            if (output == nullptr)
+            {
+                return false;
+            }
+
+            const long process = getpid();
+            uint64_t overwritten = 0;
+            const char *separator = "";
+            fprintf(output, "{\"traceEvents\":[");
+
+            std::lock_guard<std::mutex> lock(registry_lock());
+            for (auto buffer : registry())
+            {
+                fprintf(output, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%ld,"
+                                "\"args\":{\"name\":\"thread %ld\"}}",
+                        separator, process, buffer->thread, buffer->thread);
+                separator = ",";
+
+                const uint64_t head = buffer->head.load(std::memory_order_acquire);
+                const uint64_t first = (head > VARIKEY_TRACE_EVENTS) ? head - VARIKEY_TRACE_EVENTS : 0;
+                overwritten += first;
+                for (uint64_t i = first; i < head; ++i)
+                {
+                    const trace_event &item = buffer->events[i & (VARIKEY_TRACE_EVENTS - 1)];
+                    fprintf(output, ",\n{\"ph\":\"X\",\"cat\":\"varikey\",\"name\":\"%s\",\"pid\":%ld,\"tid\":%ld,"
+                                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"unique\":%u}}",
+                            item.name, process, buffer->thread,
+                            item.begin / 1000.0, (item.end - item.begin) / 1000.0, item.unique);
+                }
+            }
+
+            fprintf(output, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"overwritten\":%llu}}\n",
+                    static_cast<unsigned long long>(overwritten));
+            return fclose(output) == 0;
+        }
+    }
+}
+
+/**
+ * \brief buffers of all threads, the buffer of an ended thread keeps its
+ * spans until a new thread takes it from the released list
+ *
+ * never destroyed, threads may still record during exit
+ * @{
+ */
+static std::mutex &registry_lock()
+{
+    static std::mutex *lock = new std::mutex;
+    return *lock;
+}
+
+static std::vector<trace_buffer *> &registry()
+{
+    static std::vector<trace_buffer *> *buffers = new std::vector<trace_buffer *>;
+    return *buffers;
+}
+
+static std::vector<trace_buffer *> &released()
+{
+    static std::vector<trace_buffer *> *buffers = new std::vector<trace_buffer *>;
+    return *buffers;
+}
+/** }@ */
+
+static thread_local bool exited = false;
+
+trace_owner::~trace_owner()
+{
+    exited = true;
+    if (buffer != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registry_lock());
+        released().push_back(buffer);
+        buffer = nullptr;
+    }
+}
+
+/**
+ * \brief buffer of the calling thread, taken on first use
+ *
+ * a released buffer is reused before a new one is registered, the spans
+ * of its previous thread are dropped
+ *
+ * @return nullptr once the thread is exiting
+ */
+static trace_buffer *local_buffer()
+{
+    static thread_local trace_owner owner;
+    if (owner.buffer == nullptr && !exited)
+    {
+        std::lock_guard<std::mutex> lock(registry_lock());
+        if (released().empty())
+        {
+            owner.buffer = new trace_buffer;
+            registry().push_back(owner.buffer);
+        }
+        else
+        {
+            owner.buffer = released().back();
+            released().pop_back();
+            owner.buffer->head.store(0, std::memory_order_relaxed);
+        }
+        owner.buffer->thread = syscall(SYS_gettid);
+    }
+    return owner.buffer;
+}
@@ -0,0 +1,88 @@
+/**
+ * \file varikey_trace.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_TRACE_HPP__
+#define __VARIKEY_TRACE_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \brief trace buffers
+ * @{
+ */
+#define VARIKEY_TRACE_EVENTS 16384 /* spans per thread, power of two, the oldest are overwritten */
+/** }@ */
+
+/**
+ * \brief trace point covering the rest of the enclosing scope
+ *
+ * name is a string literal, unique the device or 0; without
+ * VARIKEY_TRACING the trace point compiles to nothing
+ * @{
+ */
+#ifdef VARIKEY_TRACING
+#define VARIKEY_TRACE_JOIN(a, b) a##b
+#define VARIKEY_TRACE_NAME(line) VARIKEY_TRACE_JOIN(trace_span_, line)
+#define VARIKEY_TRACE(name, unique) varikey::trace::span VARIKEY_TRACE_NAME(__LINE__)(name, unique)
+#else
+#define VARIKEY_TRACE(name, unique) ((void)0)
+#endif
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief timeline of gadget operations
+     *
+     * Built with VARIKEY_TRACING every trace point records a span (name,
+     * device, begin, end) into a ring buffer of the calling thread once
+     * tracing is started; the buffers of all threads are written as one
+     * Chrome trace JSON, viewable in chrome://tracing or Perfetto. Built
+     * with VARIKEY_TRACING_USDT as well, every span fires the USDT probe
+     * varikey:span while perf or bpftrace is attached to it, whether
+     * tracing is started or not.
+     */
+    namespace trace
+    {
+        bool enabled();
+        void start();
+        void stop();
+        bool write(const char *path);
+
+        void record(const char *name, const uint32_t unique, const uint64_t begin);
+        uint64_t now();
+        bool probed();
+
+        extern std::atomic<bool> active;
+
+        class span
+        {
+        public:
+            span(const char *_name, const uint32_t _unique)
+                : name(_name), unique(_unique), begin((active.load(std::memory_order_relaxed) || probed()) ? now() : 0) {}
+            ~span()
+            {
+                if (begin != 0)
+                {
+                    record(name, unique, begin);
+                }
+            }
+
+            span(const span &) = delete;
+            span &operator=(const span &) = delete;
+
+        private:
+            const char *name;
+            const uint32_t unique;
+            const uint64_t begin;
+        };
+    }
+}
+
+#endif /* __VARIKEY_TRACE_HPP__ */
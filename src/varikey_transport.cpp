@@ -0,0 +1,50 @@
+/**
+ * \file varikey_transport.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "varikey_transport.hpp"
+
+namespace varikey
+{
+    /**
+     * \brief shared hidraw transport, the default of every gadget
+     */
+    std::shared_ptr<transport> transport::hidraw()
+    {
+        static std::shared_ptr<transport> instance = std::make_shared<hidraw_transport>();
+        return instance;
+    }
+
+    int hidraw_transport::open(const char *_path, const int _flags)
+    {
+        return ::open(_path, _flags);
+    }
+
+    int hidraw_transport::close(const int _handle)
+    {
+        return ::close(_handle);
+    }
+
+    int hidraw_transport::control(const int _handle, const unsigned long _request, void *_argument)
+    {
+        return ::ioctl(_handle, _request, _argument);
+    }
+
+    ssize_t hidraw_transport::read(const int _handle, void *_buffer, const size_t _size)
+    {
+        return ::read(_handle, _buffer, _size);
+    }
+
+    bool hidraw_transport::locate(const char *_path, topology::location &_location)
+    {
+        return topology::locate(_path, _location);
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * \file varikey_transport.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_TRANSPORT_HPP__
+#define __VARIKEY_TRANSPORT_HPP__
+
+#include <cstddef>
+#include <memory>
+#include <sys/types.h>
+
+#include "varikey_topology.hpp"
+
+namespace varikey
+{
+    /**
+     * \brief device access below gadget::usb
+     *
+     * The interface is the hidraw system call boundary: open, close,
+     * ioctl with hidraw requests and non-blocking read. Handles are file
+     * descriptors that poll and epoll accept, errors are reported with -1
+     * and errno like the system calls. locate places a node on its
+     * physical gadget without opening it.
+     */
+    class transport
+    {
+    public:
+        virtual ~transport() {}
+
+        virtual int open(const char *path, const int flags) = 0;
+        virtual int close(const int handle) = 0;
+        virtual int control(const int handle, const unsigned long request, void *argument) = 0;
+        virtual ssize_t read(const int handle, void *buffer, const size_t size) = 0;
+
+        /* without a topology every node is opened and probed */
+        virtual bool locate(const char *, topology::location &) { return false; }
+
+        static std::shared_ptr<transport> hidraw();
+    };
+
+    /**
+     * \brief kernel hidraw devices
+     */
+    class hidraw_transport : public transport
+    {
+    public:
+        int open(const char *path, const int flags) override;
+        int close(const int handle) override;
+        int control(const int handle, const unsigned long request, void *argument) override;
+        ssize_t read(const int handle, void *buffer, const size_t size) override;
+        bool locate(const char *path, topology::location &) override;
+    };
+}
+
+#endif /* __VARIKEY_TRANSPORT_HPP__ */
@@ -0,0 +1,219 @@
+/**
+ * \file varikey_worker.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include "varikey_worker.hpp"
+
+namespace varikey
+{
+    io_worker::io_worker(std::shared_ptr<transport> _link) : state(std::make_shared<job>())
+    {
+        state->link = _link;
+        worker = std::thread(&io_worker::run, state);
+    }
+
+    /**
+     * \brief stop the worker
+     *
+     * a worker stuck in an abandoned call is detached, it owns the job
+     * state and releases it when the call finally returns
+     */
+    io_worker::~io_worker()
+    {
+        bool stuck = false;
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            state->stopping = true;
+            stuck = state->pending;
+        }
+        state->request.notify_one();
+
+        if (stuck)
+        {
+            worker.detach();
+        }
+        else
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * \brief run an ioctl with a deadline
+     *
+     * @param handle device handle
+     * @param request ioctl request
+     * @param argument ioctl argument, copied in and back out on completion
+     * @param size argument size
+     * @param deadline absolute CLOCK_MONOTONIC deadline in ns
+     * @param result ioctl return value
+     * @param error errno of the ioctl
+     * @return outcome DONE if result and error are valid
+     */
+    io_worker::outcome io_worker::call_ioctl(const int _handle, const unsigned long _request, void *_argument,
+                                             const size_t _size, const uint64_t _deadline, int &_result, int &_error)
+    {
+        if (_size > VARIKEY_WORKER_BUFFER)
+        {
+            _result = -1;
+            _error = EINVAL;
+            return outcome::DONE;
+        }
+
+        std::unique_lock<std::mutex> guard(state->lock);
+        if (state->pending)
+        {
+            return outcome::BUSY;
+        }
+
+        state->type = job_type::IOCTL;
+        state->handle = _handle;
+        state->code = _request;
+        state->size = _size;
+        memcpy(state->argument, _argument, _size);
+
+        const outcome value = submit(guard, _deadline);
+        if (value == outcome::DONE)
+        {
+            memcpy(_argument, state->argument, _size);
+            _result = state->result;
+            _error = state->error;
+        }
+        return value;
+    }
+
+    /**
+     * \brief open a device with a deadline
+     *
+     * a handle opened after the deadline is closed by the worker
+     */
+    io_worker::outcome io_worker::call_open(const char *_path, const int _flags, const uint64_t _deadline,
+                                            int &_result, int &_error)
+    {
+        std::unique_lock<std::mutex> guard(state->lock);
+        if (state->pending)
+        {
+            return outcome::BUSY;
+        }
+
+        state->type = job_type::OPEN;
+        state->flags = _flags;
+        strncpy(state->path, _path, sizeof(state->path) - 1);
+        state->path[sizeof(state->path) - 1] = '\0';
+
+        const outcome value = submit(guard, _deadline);
+        if (value == outcome::DONE)
+        {
+            _result = state->result;
+            _error = state->error;
+        }
+        return value;
+    }
+
+    /**
+     * \brief close a handle, deferred while an abandoned call still uses it
+     */
+    void io_worker::close_later(const int _handle)
+    {
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            if (state->pending)
+            {
+                state->close_handle = _handle;
+                return;
+            }
+        }
+        state->link->close(_handle);
+    }
+
+    bool io_worker::is_busy() const
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        return state->pending;
+    }
+
+    io_worker::outcome io_worker::submit(std::unique_lock<std::mutex> &_guard, const uint64_t _deadline)
+    {
+        state->pending = true;
+        state->finished = false;
+        state->abandoned = false;
+        state->request.notify_one();
+
+        /* steady_clock is CLOCK_MONOTONIC on linux */
+        const std::chrono::steady_clock::time_point until{std::chrono::nanoseconds(_deadline)};
+        if (!state->done.wait_until(_guard, until, [this]
+                                    { return state->finished; }))
+        {
+            state->abandoned = true;
+            return outcome::TIMEOUT;
+        }
+
+        state->pending = false;
+        return outcome::DONE;
+    }
+
+    void io_worker::run(std::shared_ptr<job> _state)
+    {
+        std::unique_lock<std::mutex> guard(_state->lock);
+        for (;;)
+        {
+            _state->request.wait(guard, [&_state]
+                                 { return _state->stopping || (_state->pending && !_state->finished); });
+            if (!(_state->pending && !_state->finished))
+            {
+                return;
+            }
+
+            const job_type type = _state->type;
+            guard.unlock();
+
+            int result = -1;
+            if (type == job_type::IOCTL)
+            {
+                result = _state->link->control(_state->handle, _state->code, _state->argument);
+            }
+            else if (type == job_type::OPEN)
+            {
+                result = _state->link->open(_state->path, _state->flags);
+            }
+            const int error = errno;
+
+            guard.lock();
+            _state->result = result;
+            _state->error = error;
+            _state->finished = true;
+
+            if (_state->abandoned)
+            {
+                /* nobody waits for the result any more */
+                if (type == job_type::OPEN && result >= 0)
+                {
+                    _state->link->close(result);
+                }
+                if (_state->close_handle >= 0)
+                {
+                    _state->link->close(_state->close_handle);
+                    _state->close_handle = -1;
+                }
+                _state->abandoned = false;
+                _state->pending = false;
+                if (_state->stopping)
+                {
+                    return;
+                }
+            }
+            else
+            {
+                _state->done.notify_one();
+            }
+        }
+    }
+}
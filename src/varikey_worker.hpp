@@ -0,0 +1,101 @@
+/**
+ * \file varikey_worker.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __VARIKEY_WORKER_HPP__
+#define __VARIKEY_WORKER_HPP__
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "varikey_transport.hpp"
+
+/**
+ * \brief largest ioctl argument copied into a job
+ * @{
+ */
+#define VARIKEY_WORKER_BUFFER 128
+#define VARIKEY_WORKER_PATH 64
+/** }@ */
+
+namespace varikey
+{
+    /**
+     * \brief runs blocking device calls on a private thread
+     *
+     * The caller waits for the call until its deadline. A call that does
+     * not finish in time is abandoned: the worker keeps blocking inside the
+     * kernel on its own copy of the argument, the caller returns at once.
+     * Until the abandoned call returns the worker rejects new jobs, and a
+     * handle closed meanwhile is closed by the worker afterwards. All
+     * calls go through the transport of the gadget.
+     */
+    class io_worker
+    {
+    public:
+        enum class outcome : uint8_t
+        {
+            DONE,
+            TIMEOUT,
+            BUSY,
+        };
+
+        explicit io_worker(std::shared_ptr<transport>);
+        virtual ~io_worker();
+
+        outcome call_ioctl(const int handle, const unsigned long request, void *argument, const size_t size,
+                           const uint64_t deadline, int &result, int &error);
+        outcome call_open(const char *path, const int flags, const uint64_t deadline, int &result, int &error);
+        void close_later(const int handle);
+
+        bool is_busy() const;
+
+    private:
+        enum class job_type : uint8_t
+        {
+            NONE,
+            IOCTL,
+            OPEN,
+        };
+
+        struct job
+        {
+            std::mutex lock;
+            std::condition_variable request;
+            std::condition_variable done;
+            std::shared_ptr<transport> link;
+
+            job_type type{job_type::NONE};
+            bool pending{false};
+            bool finished{false};
+            bool abandoned{false};
+            bool stopping{false};
+
+            int handle{-1};
+            unsigned long code{0};
+            int flags{0};
+            size_t size{0};
+            uint8_t argument[VARIKEY_WORKER_BUFFER];
+            char path[VARIKEY_WORKER_PATH];
+
+            int result{-1};
+            int error{0};
+            int close_handle{-1};
+        };
+
+        outcome submit(std::unique_lock<std::mutex> &, const uint64_t deadline);
+        static void run(std::shared_ptr<job>);
+
+        std::shared_ptr<job> state;
+        std::thread worker;
+    };
+}
+
+#endif /* __VARIKEY_WORKER_HPP__ */
@@ -6,20 +6,63 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
+#include "varikey_animation.hpp"
+#include "varikey_binding.hpp"
+#include "varikey_board.hpp"
+#include "varikey_encoder.hpp"
+#include "varikey_group.hpp"
+#include "varikey_input.hpp"
+#include "varikey_loopback.hpp"
+#include "varikey_reactor.hpp"
+#include "varikey_ticker.hpp"
+#include "varikey_trace.hpp"
 #include "wizard_args.hpp"
+#include "wizard_dashboard.hpp"
+#include "wizard_follow.hpp"
+#include "wizard_probe.hpp"
+#include "wizard_realtime.hpp"
 #include "wizard_usb.hpp"
 
 static void reset_device(wizard::usb &, const uint32_t unique);
 static void set_position(wizard::usb &, const uint32_t unique, const uint8_t line, const uint8_t column);
 static void draw_icon(wizard::usb &, const uint32_t unique, const uint8_t icon);
-static void set_font_size(wizard::usb &, const uint32_t unique, const uint8_t font_size);
-static void print_text(wizard::usb &, const uint32_t unique, const std::string &text);
+static void print_text(wizard::usb &, const uint32_t unique, const uint8_t line, const uint8_t column,
+					   const uint8_t font_size, const std::string_view text);
 static void get_temperature(wizard::usb &, const uint32_t unique);
 static void set_backlight(wizard::usb &, const uint32_t unique, const uint8_t mode);
 static void set_backlight_color(wizard::usb &, const uint32_t unique, const uint8_t r, const uint8_t g, const uint8_t b);
+static void run_dashboard(wizard::usb &, const uint32_t unique, const char *path, const uint32_t interval);
+static void run_board(wizard::usb &, const uint32_t unique, const uint32_t interval);
+static void post_board(const wizard::arguments &);
+static void run_follow(wizard::usb &, const wizard::arguments &);
+static void run_binding(wizard::usb &, const wizard::arguments &);
+static void run_events(wizard::usb &, const uint32_t unique, const uint32_t interval, const bool accelerate);
+static void run_group(wizard::usb &, const wizard::arguments &);
+static bool run_probe(wizard::usb &, const wizard::arguments &);
+static void run_jitter(wizard::usb &, const uint32_t unique, const uint32_t cycles, const uint32_t interval);
+static void run_marquee(wizard::usb &, const wizard::arguments &);
+static void run_animation(wizard::usb &, const wizard::arguments &);
+
+static std::shared_ptr<varikey::loopback> create_loopback(const char *spec);
+
+static volatile sig_atomic_t running = 1;
+static void stop_running(int) { running = 0; }
 
 int main(int argc, char *argv[])
 {
@@ -29,20 +72,99 @@ int main(int argc, char *argv[])
 
 	static const bool VERBOSE_OUTPUT = arguments.verbose;
 
+	if (arguments.post != false)
+	{
+		post_board(arguments);
+		return 0;
+	}
+
+	if (arguments.trace != nullptr)
+	{
+		if (!varikey::trace::enabled())
+		{
+			std::cout << "tracing is not built in, configure with -DVARIKEY_TRACING=ON" << std::endl;
+			return 1;
+		}
+		varikey::trace::start();
+	}
+
 	wizard::usb wizard_usb_object;
 
 	if (VERBOSE_OUTPUT)
 		std::cout << "start " << argv[0] << std::endl;
 
+	if (arguments.loopback != nullptr)
+	{
+		std::shared_ptr<varikey::loopback> loopback = create_loopback(arguments.loopback);
+		if (loopback == nullptr)
+		{
+			std::cout << "invalid loopback " << arguments.loopback << std::endl;
+			return 1;
+		}
+		wizard_usb_object.set_transport(loopback);
+		arguments.device = "loop";
+	}
+
 	if (arguments.device != nullptr)
 	{
 		if (VERBOSE_OUTPUT)
 			std::cout << "scan devices" << std::endl;
 
+		wizard_usb_object.set_timeout(arguments.timeout * 1000000ULL);
 		wizard_usb_object.scan_devices(arguments.device);
 	}
 
-	if (arguments.reset != false)
+	if (arguments.realtime >= 0)
+	{
+		if (VERBOSE_OUTPUT)
+			std::cout << "enter real-time mode" << std::endl;
+
+		wizard::realtime::enter({arguments.realtime, arguments.cpu});
+	}
+
+	int result = 0;
+	if (arguments.probe != false)
+	{
+		/* a probe that allocated on the hot path fails */
+		result = run_probe(wizard_usb_object, arguments) ? 0 : 1;
+	}
+	else if (arguments.group != false)
+	{
+		run_group(wizard_usb_object, arguments);
+	}
+	else if (arguments.jitter > 0)
+	{
+		run_jitter(wizard_usb_object, arguments.unique, arguments.jitter, arguments.interval);
+	}
+	else if (arguments.dashboard != nullptr)
+	{
+		run_dashboard(wizard_usb_object, arguments.unique, arguments.dashboard, arguments.interval);
+	}
+	else if (arguments.board != false)
+	{
+		run_board(wizard_usb_object, arguments.unique, arguments.interval);
+	}
+	else if (arguments.binding != nullptr)
+	{
+		run_binding(wizard_usb_object, arguments);
+	}
+	else if (arguments.events != false)
+	{
+		run_events(wizard_usb_object, arguments.unique, arguments.interval, arguments.accelerate);
+	}
+	else if (arguments.marquee > 0 && arguments.text != nullptr)
+	{
+		run_marquee(wizard_usb_object, arguments);
+	}
+	else if (arguments.animation != nullptr)
+	{
+		run_animation(wizard_usb_object, arguments);
+	}
+	else if (arguments.follow != false)
+	{
+		run_follow(wizard_usb_object, arguments);
+	}
+	else if (arguments.reset != false)
 	{
 		reset_device(wizard_usb_object, arguments.unique);
 	}
@@ -68,11 +190,14 @@ int main(int argc, char *argv[])
 			wizard_usb_object.list_devices();
 		}
 
-		if (arguments.column != 0xff && arguments.line != 0xff)
+		/* a position for the text goes out with it */
+		const bool positioned = (arguments.column != 0xff && arguments.line != 0xff);
+		const bool printing = (arguments.icon == 0xff && arguments.text != nullptr && arguments.unique != 0);
+		if (positioned && !printing)
 		{
 			set_position(wizard_usb_object, arguments.unique, arguments.line, arguments.column);
 		}
-		else if (!(arguments.column == 0xff && arguments.line == 0xff))
+		else if (!positioned && !(arguments.column == 0xff && arguments.line == 0xff))
 		{
 			std::cout << "needs row and column values to set position" << std::endl;
 		}
@@ -85,12 +210,8 @@ int main(int argc, char *argv[])
 		{
 			if (arguments.unique != 0)
 			{
-				if (arguments.font_size != 0xff)
-				{
-					set_font_size(wizard_usb_object, arguments.unique, arguments.font_size);
-				}
-
-				print_text(wizard_usb_object, arguments.unique, arguments.text);
+				print_text(wizard_usb_object, arguments.unique, positioned ? arguments.line : 0xff,
+						   arguments.column, arguments.font_size, arguments.text);
 			}
 			else
 			{
@@ -99,7 +220,16 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	return 0;
+	if (arguments.trace != nullptr)
+	{
+		varikey::trace::stop();
+		if (!varikey::trace::write(arguments.trace))
+		{
+			std::cout << "unable to write trace " << arguments.trace << std::endl;
+		}
+	}
+
+	return result;
 }
 
 static void reset_device(wizard::usb &wizard_usb_object, const uint32_t unique)
@@ -146,13 +276,28 @@ static void draw_icon(wizard::usb &wizard_usb_object, const uint32_t unique,
 	}
 }
 
-static void set_font_size(wizard::usb &wizard_usb_object, const uint32_t unique,
-						  const uint8_t font_size)
+/**
+ * \brief position, font size and text in one go, 0xff skips line or font size
+ */
+static void print_text(wizard::usb &wizard_usb_object, const uint32_t unique, const uint8_t line, const uint8_t column,
+					   const uint8_t font_size, const std::string_view text)
 {
 	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
 	if (gadget.is_valid() && gadget.is_open())
 	{
-		gadget.set_font_size(font_size);
+		varikey::command commands[3];
+		size_t count = 0;
+		if (line != 0xff)
+		{
+			commands[count++] = varikey::encode_position(line, column);
+		}
+		if (font_size != 0xff)
+		{
+			commands[count++] = varikey::encode_font_size(font_size);
+		}
+		commands[count++] = varikey::encode_text(text);
+
+		gadget.send_commands(commands, count);
 		wizard_usb_object.close_device(gadget);
 	}
 	else
@@ -161,13 +306,26 @@ static void set_font_size(wizard::usb &wizard_usb_object, const uint32_t unique,
 	}
 }
 
-static void print_text(wizard::usb &wizard_usb_object, const uint32_t unique,
-					   const std::string &text)
+static void get_temperature(wizard::usb &wizard_usb_object, const uint32_t unique)
 {
 	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
 	if (gadget.is_valid() && gadget.is_open())
 	{
-		gadget.print_text(text.c_str());
+		float value = 0;
+		switch (gadget.get_temperature(value))
+		{
+		case varikey::gadget::status::SUCCESS:
+			std::cout << "device " << unique << " temperature " << value << std::endl;
+			break;
+		case varikey::gadget::status::TIMEOUT:
+		case varikey::gadget::status::BUSY:
+			std::cout << "device " << unique << " timeout" << std::endl;
+			break;
+		default:
+			std::cout << "device " << unique << " temperature unavailable" << std::endl;
+			break;
+		}
+
 		wizard_usb_object.close_device(gadget);
 	}
 	else
@@ -176,14 +334,13 @@ static void print_text(wizard::usb &wizard_usb_object, const uint32_t unique,
 	}
 }
 
-static void get_temperature(wizard::usb &wizard_usb_object, const uint32_t unique)
+static void set_backlight(wizard::usb &wizard_usb_object, const uint32_t unique,
+						  const uint8_t mode)
 {
 	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
 	if (gadget.is_valid() && gadget.is_open())
 	{
-		float value = gadget.get_temperature();
-		std::cout << "device " << unique << " temperature " << value << std::endl;
-
+		gadget.set_backlight_mode(mode);
 		wizard_usb_object.close_device(gadget);
 	}
 	else
@@ -192,13 +349,13 @@ static void get_temperature(wizard::usb &wizard_usb_object, const uint32_t uniqu
 	}
 }
 
-static void set_backlight(wizard::usb &wizard_usb_object, const uint32_t unique,
-						  const uint8_t mode)
+static void set_backlight_color(wizard::usb &wizard_usb_object, const uint32_t unique,
+								const uint8_t r, const uint8_t g, const uint8_t b)
 {
 	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
 	if (gadget.is_valid() && gadget.is_open())
 	{
-		gadget.set_backlight_mode(mode);
+		gadget.set_backlight_color(r, g, b);
 		wizard_usb_object.close_device(gadget);
 	}
 	else
@@ -207,17 +364,640 @@ static void set_backlight(wizard::usb &wizard_usb_object, const uint32_t unique,
 	}
 }
 
-static void set_backlight_color(wizard::usb &wizard_usb_object, const uint32_t unique,
-								const uint8_t r, const uint8_t g, const uint8_t b)
+static void run_dashboard(wizard::usb &wizard_usb_object, const uint32_t unique,
+						  const char *path, const uint32_t interval)
 {
+	wizard::dashboard dashboard;
+	if (!dashboard.load(path))
+	{
+		return;
+	}
+
 	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
-	if (gadget.is_valid() && gadget.is_open())
+	if (!(gadget.is_valid() && gadget.is_open()))
 	{
-		gadget.set_backlight_color(r, g, b);
+		std::cout << "invalid device" << std::endl;
+		return;
+	}
+
+	/* icons and backlight colors superseded within one rate slot are dropped */
+	gadget.set_rate_policy(varikey::rate_controller::policy::COALESCE);
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	while (running)
+	{
+		if (!gadget.is_open())
+		{
+			std::cout << "device " << unique << " lost" << std::endl;
+			if (!wizard_usb_object.reconnect(gadget, 1000))
+			{
+				continue;
+			}
+			std::cout << "device " << unique << " restored" << std::endl;
+			dashboard.invalidate();
+		}
+
+		dashboard.update(gadget);
+		if (gadget.get_send_delay(varikey::rate_controller::now()) == 0)
+		{
+			gadget.flush();
+		}
+
+		deadline.tv_nsec += static_cast<long>(interval % 1000) * 1000000L;
+		deadline.tv_sec += interval / 1000 + deadline.tv_nsec / 1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+	}
+
+	wizard_usb_object.close_device(gadget);
+}
+
+static void run_board(wizard::usb &wizard_usb_object, const uint32_t unique, const uint32_t interval)
+{
+	varikey::board board;
+	if (!board.attach(unique))
+	{
+		return;
+	}
+
+	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
+	if (!(gadget.is_valid() && gadget.is_open()))
+	{
+		std::cout << "invalid device" << std::endl;
+		return;
+	}
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	varikey::board_driver driver(board, gadget);
+	driver.start(interval);
+
+	while (running)
+	{
+		if (!driver.is_running())
+		{
+			std::cout << "device " << unique << " lost" << std::endl;
+			if (wizard_usb_object.reconnect(gadget, 1000))
+			{
+				std::cout << "device " << unique << " restored" << std::endl;
+				driver.start(interval);
+			}
+			continue;
+		}
+		usleep(100000);
+	}
+
+	driver.stop();
+
+	std::cout << "device " << unique << " flushes " << driver.get_flushes()
+			  << " fields " << driver.get_fields() << std::endl;
+
+	wizard_usb_object.close_device(gadget);
+}
+
+static void post_board(const wizard::arguments &arguments)
+{
+	if (arguments.unique == 0)
+	{
+		std::cout << "needs unique identifier to post" << std::endl;
+		return;
+	}
+
+	varikey::board board;
+	if (!board.attach(arguments.unique))
+	{
+		return;
+	}
+
+	if (arguments.backlight == 0xaa)
+	{
+		board.post_backlight_color(arguments.r_value, arguments.g_value, arguments.b_value);
+	}
+	else if (arguments.backlight != 0xff)
+	{
+		board.post_backlight_mode(arguments.backlight);
+	}
+
+	if (arguments.icon != 0xff)
+	{
+		board.post_icon(arguments.icon);
+	}
+	else if (arguments.text != nullptr)
+	{
+		board.post_text(arguments.line != 0xff ? arguments.line : 0,
+						arguments.column != 0xff ? arguments.column : 0,
+						arguments.font_size != 0xff ? arguments.font_size : 0,
+						arguments.text);
+	}
+}
+
+static void run_follow(wizard::usb &wizard_usb_object, const wizard::arguments &arguments)
+{
+	varikey::gadget::usb &gadget = wizard_usb_object.open_device(arguments.unique);
+	if (!(gadget.is_valid() && gadget.is_open()))
+	{
+		std::cout << "invalid device" << std::endl;
+		return;
+	}
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	wizard::follow follow(gadget,
+						  arguments.line != 0xff ? arguments.line : 0,
+						  arguments.rows,
+						  arguments.column != 0xff ? arguments.column : 0,
+						  arguments.font_size);
+	follow.run(STDIN_FILENO, running);
+
+	std::cerr << "device " << arguments.unique << " lines " << follow.get_received()
+			  << " shown " << follow.get_shown() << " dropped " << follow.get_dropped() << std::endl;
+
+	wizard_usb_object.close_device(gadget);
+}
+
+static void run_jitter(wizard::usb &wizard_usb_object, const uint32_t unique,
+					   const uint32_t cycles, const uint32_t interval)
+{
+	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
+	const bool valid = gadget.is_valid() && gadget.is_open();
+	if (!valid)
+	{
+		std::cout << "no device, measure host wakeups only" << std::endl;
+	}
+
+	wizard::realtime::jitter jitter(cycles);
+	jitter.measure(valid ? &gadget : nullptr, static_cast<uint64_t>(interval) * 1000000ULL);
+	jitter.print();
+
+	wizard_usb_object.close_device(gadget);
+}
+
+static bool run_probe(wizard::usb &wizard_usb_object, const wizard::arguments &arguments)
+{
+	std::vector<uint32_t> uniques(arguments.uniques, arguments.uniques + arguments.unique_count);
+	if (uniques.empty())
+	{
+		uniques = wizard_usb_object.get_uniques();
+	}
+
+	if (uniques.empty())
+	{
+		std::cout << "no devices found" << std::endl;
+		return true;
+	}
+
+	wizard::probe probe(wizard_usb_object, arguments.count);
+	probe.run(uniques);
+	probe.print();
+	return probe.get_allocations() == 0;
+}
+
+/**
+ * @brief gadget served by a binding reactor
+ */
+struct bound_device
+{
+	uint32_t unique;
+	varikey::gadget::usb *gadget;
+	varikey::input::decoder decoder;
+	std::atomic<bool> lost; /* set on the reactor thread, cleared by the rescan */
+};
+
+static void attach_binding(varikey::reactor &reactor, bound_device &device, varikey::binding &binding)
+{
+	device.lost = !reactor.attach(
+		*device.gadget,
+		[&device, &binding](varikey::gadget::usb &gadget, const uint8_t *report, const size_t length)
+		{
+			varikey::input::event events[2 * VARIKEY_KEYBOARD_KEYS];
+			size_t count = device.decoder.decode(report, length, varikey::rate_controller::now(),
+												 events, sizeof(events) / sizeof(events[0]));
+			for (size_t i = 0; i < count; ++i)
+			{
+				binding.dispatch(device.unique, events[i], gadget);
+			}
+		},
+		[&device](varikey::gadget::usb &)
+		{
+			device.lost = true;
+		});
+}
+
+/**
+ * @brief serve the binding table on all given gadgets
+ *
+ * gadgets are sharded over one reactor per core, a lost gadget is
+ * reopened by a rescan thread when a new hidraw node appears and
+ * reattached on its reactor
+ */
+static void run_binding(wizard::usb &wizard_usb_object, const wizard::arguments &arguments)
+{
+	varikey::binding binding;
+	if (!binding.load(arguments.binding))
+	{
+		return;
+	}
+
+	std::vector<uint32_t> uniques(arguments.uniques, arguments.uniques + arguments.unique_count);
+	if (uniques.empty())
+	{
+		uniques.push_back(arguments.unique);
+	}
+
+	/* one reactor per core, not more than gadgets */
+	const size_t cores = std::max(1U, std::thread::hardware_concurrency());
+	varikey::reactor_pool pool(std::min(cores, uniques.size()));
+
+	std::vector<bound_device> devices(uniques.size());
+	size_t attached = 0;
+	for (size_t i = 0; i < uniques.size(); ++i)
+	{
+		bound_device &device = devices[i];
+		device.unique = uniques[i];
+		device.gadget = &wizard_usb_object.open_device(uniques[i]);
+		device.lost = true;
+		if (!(device.gadget->is_valid() && device.gadget->is_open()))
+		{
+			std::cout << "invalid device " << uniques[i] << std::endl;
+			continue;
+		}
+
+		attach_binding(pool.shard(device.unique), device, binding);
+		attached += device.lost ? 0 : 1;
+	}
+
+	if (attached == 0)
+	{
+		return;
+	}
+
+	const std::string pattern(arguments.device);
+	const size_t separator = pattern.rfind('/');
+	const std::string directory = (separator == std::string::npos) ? "." : pattern.substr(0, separator);
+	const std::string node = pattern.substr(separator + 1);
+
+	/* the rescan opens and identifies nodes, that must not stall a reactor */
+	std::mutex rescan_lock;
+	std::condition_variable rescan_signal;
+	bool rescan = false;
+	bool rescan_stop = false;
+
+	pool.at(0).watch_hotplug(directory.c_str(), [&](const char *name, const bool added)
+							 {
+								 if (!added || strncmp(name, node.c_str(), node.length()) != 0)
+								 {
+									 return;
+								 }
+								 {
+									 std::lock_guard<std::mutex> guard(rescan_lock);
+									 rescan = true;
+								 }
+								 rescan_signal.notify_one(); });
+
+	std::thread rescanner([&]()
+						  {
+							  std::unique_lock<std::mutex> guard(rescan_lock);
+							  for (;;)
+							  {
+								  rescan_signal.wait(guard, [&]()
+													 { return rescan || rescan_stop; });
+								  if (rescan_stop)
+								  {
+									  return;
+								  }
+								  rescan = false;
+								  guard.unlock();
+
+								  for (auto &device : devices)
+								  {
+									  if (device.lost && device.gadget->is_valid() &&
+										  wizard_usb_object.reconnect(*device.gadget, 0))
+									  {
+										  device.lost = false;
+										  varikey::reactor &reactor = pool.shard(device.unique);
+										  reactor.post([&reactor, &device, &binding]()
+													   { attach_binding(reactor, device, binding); });
+									  }
+								  }
+								  guard.lock();
+							  } });
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	pool.start();
+	while (running)
+	{
+		usleep(100000);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(rescan_lock);
+		rescan_stop = true;
+	}
+	rescan_signal.notify_one();
+	rescanner.join();
+	pool.stop();
+
+	for (auto &device : devices)
+	{
+		wizard_usb_object.close_device(*device.gadget);
+	}
+}
+
+static void run_events(wizard::usb &wizard_usb_object, const uint32_t unique,
+					   const uint32_t interval, const bool accelerate)
+{
+	varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
+	if (!(gadget.is_valid() && gadget.is_open()))
+	{
+		std::cout << "invalid device" << std::endl;
+		return;
+	}
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	varikey::encoder encoder;
+	varikey::encoder::acceleration setup = encoder.get_acceleration();
+	setup.enabled = accelerate;
+	encoder.configure(setup);
+
+	varikey::input::decoder decoder;
+	uint8_t report[VARIKEY_INPUT_REPORT_SIZE];
+	varikey::input::event events[2 * VARIKEY_KEYBOARD_KEYS];
+
+	const uint64_t period = static_cast<uint64_t>(interval) * 1000000ULL;
+	uint64_t next_read = varikey::rate_controller::now() + period;
+
+	while (running && gadget.is_open())
+	{
+		uint64_t now = varikey::rate_controller::now();
+		int timeout = (next_read > now) ? static_cast<int>((next_read - now + 999999ULL) / 1000000ULL) : 0;
+
+		int length = gadget.read_input(report, sizeof(report), timeout);
+		if (length > 0)
+		{
+			size_t count = decoder.decode(report, length, varikey::rate_controller::now(),
+										  events, sizeof(events) / sizeof(events[0]));
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (events[i].kind == varikey::input::type::ENCODER)
+				{
+					encoder.feed(events[i]);
+				}
+				else
+				{
+					std::cout << ((events[i].kind == varikey::input::type::KEY_PRESS) ? "press " : "release ")
+							  << static_cast<int>(events[i].code) << std::endl;
+				}
+			}
+		}
+
+		now = varikey::rate_controller::now();
+		if (now >= next_read)
+		{
+			varikey::encoder::delta delta;
+			if (encoder.read(delta))
+			{
+				std::cout << "encoder " << std::showpos << delta.value << std::noshowpos
+						  << " steps " << delta.steps << " at " << delta.timestamp << std::endl;
+			}
+			next_read = now + period;
+		}
+	}
+
+	wizard_usb_object.close_device(gadget);
+}
+
+static void run_group(wizard::usb &wizard_usb_object, const wizard::arguments &arguments)
+{
+	std::vector<uint32_t> uniques(arguments.uniques, arguments.uniques + arguments.unique_count);
+	if (uniques.empty())
+	{
+		uniques = wizard_usb_object.get_uniques();
+	}
+
+	varikey::command commands[VARIKEY_GROUP_COMMANDS];
+	size_t count = 0;
+	if (arguments.backlight == 0xaa)
+	{
+		commands[count++] = varikey::encode_backlight_color(arguments.r_value, arguments.g_value, arguments.b_value);
+	}
+	else if (arguments.backlight != 0xff)
+	{
+		commands[count++] = varikey::encode_backlight_mode(arguments.backlight);
+	}
+	if (arguments.icon != 0xff)
+	{
+		commands[count++] = varikey::encode_icon(arguments.icon);
+	}
+
+	if (count == 0)
+	{
+		std::cout << "needs backlight or icon for the group" << std::endl;
+		return;
+	}
+
+	varikey::group group;
+	std::vector<varikey::gadget::usb *> gadgets;
+	for (auto unique : uniques)
+	{
+		varikey::gadget::usb &gadget = wizard_usb_object.open_device(unique);
+		if (gadget.is_valid() && gadget.is_open())
+		{
+			group.add(gadget, commands, count);
+			gadgets.push_back(&gadget);
+		}
+		else
+		{
+			std::cout << "invalid device " << unique << std::endl;
+		}
+	}
+
+	if (group.size() > 0)
+	{
+		varikey::group::skew skew = group.execute(VARIKEY_GROUP_LEAD);
+		std::cout << "devices " << group.size()
+				  << " release skew " << skew.release / 1000.0 << " us"
+				  << " completion skew " << skew.completion / 1000.0 << " us"
+				  << " lateness " << skew.lateness / 1000.0 << " us" << std::endl;
+	}
+
+	for (auto i : gadgets)
+	{
+		wizard_usb_object.close_device(*i);
+	}
+}
+
+/**
+ * @brief scroll the message on one display line
+ *
+ * the ticker is driven by a reactor timer, input reports are drained
+ */
+static void run_marquee(wizard::usb &wizard_usb_object, const wizard::arguments &arguments)
+{
+	varikey::gadget::usb &gadget = wizard_usb_object.open_device(arguments.unique);
+	if (!(gadget.is_valid() && gadget.is_open()))
+	{
+		std::cout << "invalid device" << std::endl;
+		return;
+	}
+
+	varikey::ticker::setup setup;
+	setup.line = (arguments.line != 0xff) ? arguments.line : 0;
+	setup.column = (arguments.column != 0xff) ? arguments.column : 0;
+	setup.font_size = (arguments.font_size != 0xff) ? arguments.font_size : 0;
+	setup.width = 0;
+	setup.step = static_cast<uint64_t>(arguments.marquee) * 1000000ULL;
+
+	varikey::ticker ticker;
+	if (!ticker.add(setup, arguments.text))
+	{
+		std::cout << "message does not fit the display" << std::endl;
 		wizard_usb_object.close_device(gadget);
+		return;
 	}
-	else
+
+	varikey::reactor reactor;
+	reactor.attach(gadget, nullptr, [](varikey::gadget::usb &)
+				   { running = 0; });
+	ticker.tick(gadget, varikey::rate_controller::now());
+	if (ticker.get_period() > 0)
+	{
+		reactor.add_timer(ticker.get_period(), [&](const uint64_t)
+						  { ticker.tick(gadget, varikey::rate_controller::now()); });
+	}
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	std::thread loop(&varikey::reactor::run, &reactor);
+	while (running)
+	{
+		usleep(100000);
+	}
+	reactor.stop();
+	loop.join();
+
+	if (arguments.verbose)
+	{
+		std::cout << "frames " << ticker.get_frames() << " characters " << ticker.get_characters() << std::endl;
+	}
+	wizard_usb_object.close_device(gadget);
+}
+
+/**
+ * @brief play an icon sequence until it ends or the user stops it
+ *
+ * frames are drawn from a reactor timer hitting every frame boundary
+ */
+static void run_animation(wizard::usb &wizard_usb_object, const wizard::arguments &arguments)
+{
+	varikey::animation::frame frames[VARIKEY_ANIMATION_FRAMES];
+	size_t count = 0;
+	for (const char *position = arguments.animation; *position != '\0' && count < VARIKEY_ANIMATION_FRAMES; ++count)
+	{
+		unsigned int icon = 0, duration = 0;
+		int length = 0;
+		if (sscanf(position, "%u:%u%n", &icon, &duration, &length) != 2 || icon > 0xfe || duration == 0)
+		{
+			std::cout << "invalid icon sequence " << arguments.animation << std::endl;
+			return;
+		}
+		frames[count] = {static_cast<uint8_t>(icon), duration * 1000000ULL};
+		position += length;
+		position += (*position == ',') ? 1 : 0;
+	}
+
+	varikey::gadget::usb &gadget = wizard_usb_object.open_device(arguments.unique);
+	if (!(gadget.is_valid() && gadget.is_open()))
 	{
 		std::cout << "invalid device" << std::endl;
+		return;
+	}
+
+	varikey::animation player;
+	player.play(frames, count, arguments.once ? varikey::animation::mode::ONCE : varikey::animation::mode::LOOP);
+
+	varikey::reactor reactor;
+	reactor.attach(gadget, nullptr, [](varikey::gadget::usb &)
+				   { running = 0; });
+	/* one wakeup per frame, re-armed at the next frame end */
+	const uint64_t now = varikey::rate_controller::now();
+	player.tick(gadget, now);
+	reactor.add_alarm(player.get_next(now), [&](const uint64_t _now)
+					  {
+						  player.tick(gadget, _now);
+						  if (!player.is_playing())
+						  {
+							  running = 0;
+						  }
+						  return player.get_next(_now); });
+
+	signal(SIGINT, stop_running);
+	signal(SIGTERM, stop_running);
+
+	std::thread loop(&varikey::reactor::run, &reactor);
+	while (running)
+	{
+		usleep(10000);
+	}
+	reactor.stop();
+	loop.join();
+	player.cancel();
+
+	if (arguments.verbose)
+	{
+		const varikey::animation::counters &value = player.get_counters();
+		printf("frames %llu reports %llu skipped %llu\n",
+			   static_cast<unsigned long long>(value.frames), static_cast<unsigned long long>(value.reports),
+			   static_cast<unsigned long long>(value.skipped));
+		if (value.frames > 0)
+		{
+			printf("lateness us mean %.1f max %.1f\n",
+				   value.lateness_total / 1000.0 / value.frames, value.lateness_max / 1000.0);
+		}
+	}
+	wizard_usb_object.close_device(gadget);
+}
+
+/**
+ * @brief loopback gadgets loop0..loopN-1 with uniques 1..N
+ *
+ * @param spec COUNT[:LATENCY_US[:JITTER_US[:ERRORS_PPM[:VERSION]]]]
+ */
+static std::shared_ptr<varikey::loopback> create_loopback(const char *spec)
+{
+	unsigned int count = 0, latency = 0, jitter = 0, errors = 0;
+	int version = 1;
+	if (sscanf(spec, "%u:%u:%u:%u:%i", &count, &latency, &jitter, &errors, &version) < 1 || count == 0 || count > 16)
+	{
+		return nullptr;
+	}
+
+	std::shared_ptr<varikey::loopback> loopback = std::make_shared<varikey::loopback>();
+	loopback->configure({latency * 1000ULL, jitter * 1000ULL, errors, 0});
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		varikey::device identity = {};
+		snprintf(identity.name, sizeof(identity.name), "loopback %u", i);
+		identity.unique = i + 1;
+		identity.gadget = varikey::gadget::type::DISPLAY;
+		identity.hardware = 1;
+		identity.version = version;
+
+		char path[VARIKEY_PATH_SIZE];
+		snprintf(path, sizeof(path), "loop%u", i);
+		loopback->add_device(path, identity);
 	}
+	return loopback;
 }
@@ -8,8 +8,10 @@
 
 #include <argp.h>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
+#include "varikey_snapshot.hpp"
 #include "wizard_args.hpp"
 #include "wizard_revision.h"
 
@@ -20,17 +22,37 @@ const char *argp_program_bug_address = ADDRESS();
 
 static struct argp_option options[] =
     {
+        {"bind", 'k', "TABLE", 0, "run key binding table on gadget input, one reactor per core", 60},
+        {"animate", 'A', "SEQUENCE", 0, "play icon sequence ICON:MS[,ICON:MS...] in a loop", 30},
+        {"accelerate", 'a', 0, 0, "accelerate encoder deltas by spin velocity", 60},
         {"backlight", 'b', "MODE", 0, "set the backlight mode (check the docs)", 40},
         {"backcolor", 'B', "RGB", 0, "set the backlight color with hex RRGGBB (check the docs)", 40},
+        {"dashboard", 'D', "TEMPLATE", 0, "run dashboard template on gadget", 60},
+        {"cpu", 'C', "CPU", 0, "pin real-time mode to a cpu", 70},
         {"device", 'd', "DEVICE", 0, "device path", 10},
+        {"events", 'e', 0, 0, "show key events and encoder deltas merged per -I period", 60},
+        {"follow", 'F', 0, 0, "stream stdin lines to gadget, latest line wins", 60},
         {"font", 'f', "FONT", 0, "set font size (check the docs)", 20},
+        {"group", 'g', 0, 0, "apply -b/-B and -i to all -u gadgets at one deadline", 60},
         {"icon", 'i', "ICON", 0, "draw predefined icon (check the docs)", 30},
+        {"interval", 'I', "MS", 0, "dashboard update interval in milliseconds", 60},
+        {"jitter", 'J', "CYCLES", 0, "measure wakeup and report jitter for CYCLES periods of -I", 70},
         {"list", 'l', "PATH", 0, "devices list", 10},
+        {"loopback", 'L', "SPEC", 0, "in-process gadgets COUNT[:LATENCY_US[:JITTER_US[:ERRORS_PPM[:VERSION]]]] instead of hidraw", 10},
+        {"count", 'n', "COUNT", 0, "probe iterations per report type", 70},
         {"message", 'm', "TEXT", 0, "show message string on gadget", 20},
+        {"marquee", 'M', "MS", 0, "scroll the -m message on line -y, one character every MS", 20},
+        {"trace", 'O', "FILE", 0, "write a chrome trace of all gadget operations to FILE (tracing builds)", 70},
+        {"once", 'o', 0, 0, "play the -A icon sequence once", 30},
+        {"post", 'P', 0, 0, "post output to the status board instead of the gadget", 60},
         {"reset", 'r', 0, 0, "reset wizard device", 10},
+        {"rows", 'R', "ROWS", 0, "rows of the follow scrolling region", 60},
+        {"board", 'S', 0, 0, "serve the shared memory status board on gadget", 60},
+        {"realtime", 'T', "PRIORITY", 0, "real-time mode, locked memory and SCHED_FIFO priority (0 locks memory only)", 70},
         {"temperature", 't', 0, 0, "show gadget processor temperature", 50},
-        {"unique", 'u', "UNIQUE", 0, "get unique gadget identifier", 10},
+        {"unique", 'u', "UNIQUE", 0, "get unique gadget identifier, probe and bind accept several", 10},
         {"verbose", 'v', 0, 0, "more output", 10},
+        {"timeout", 'w', "MS", 0, "deadline of every gadget operation in milliseconds", 10},
         {"column", 'x', "COLUMN", 0, "set the column for the next output (0-127)", 20},
         {"line", 'y', "LINE", 0, "set the line for the next output (0-3)", 20},
         {0},
@@ -41,6 +63,12 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
     struct wizard::arguments *arguments = (struct wizard::arguments *)state->input;
     switch (key)
     {
+    case 'A':
+        arguments->animation = arg;
+        break;
+    case 'a':
+        arguments->accelerate = true;
+        break;
     case 'b':
         arguments->backlight = std::stoi(arg);
         break;
@@ -62,34 +90,92 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         }
     }
     break;
+    case 'C':
+        arguments->cpu = std::stoi(arg);
+        break;
     case 'd':
         arguments->device = arg;
         break;
+    case 'D':
+        arguments->dashboard = arg;
+        break;
+    case 'e':
+        arguments->events = true;
+        break;
+    case 'F':
+        arguments->follow = true;
+        break;
     case 'f':
         arguments->font_size = std::stoi(arg);
         break;
+    case 'g':
+        arguments->group = true;
+        break;
     case 'i':
         arguments->icon = std::stoi(arg);
         break;
+    case 'I':
+        arguments->interval = std::stoi(arg);
+        break;
+    case 'J':
+        arguments->jitter = std::stoul(arg);
+        break;
+    case 'k':
+        arguments->binding = arg;
+        break;
     case 'l':
         arguments->list = true;
         arguments->device = arg;
         break;
+    case 'n':
+        arguments->count = std::stoul(arg);
+        break;
+    case 'L':
+        arguments->loopback = arg;
+        break;
     case 'm':
         arguments->text = arg;
         break;
+    case 'M':
+        arguments->marquee = std::stoul(arg);
+        break;
+    case 'O':
+        arguments->trace = arg;
+        break;
+    case 'o':
+        arguments->once = true;
+        break;
+    case 'P':
+        arguments->post = true;
+        break;
     case 'r':
         arguments->reset = true;
         break;
+    case 'R':
+        arguments->rows = std::stoi(arg);
+        break;
+    case 'S':
+        arguments->board = true;
+        break;
+    case 'T':
+        arguments->realtime = std::stoi(arg);
+        break;
     case 't':
         arguments->temperature = true;
         break;
     case 'u':
         arguments->unique = std::stol(arg);
+        if (arguments->unique_count < WIZARD_UNIQUE_LIMIT)
+        {
+            arguments->uniques[arguments->unique_count++] = arguments->unique;
+        }
         break;
     case 'v':
         arguments->verbose = true;
         break;
+    case 'w':
+        arguments->timeout = std::stoul(arg);
+        break;
     case 'x':
         arguments->column = std::stoi(arg);
         break;
@@ -101,8 +187,26 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
             argp_usage(state);
         break;
     case ARGP_KEY_ARG:
+        if (strcmp(arg, "probe") == 0)
+        {
+            arguments->probe = true;
+        }
+        else
+        {
+            argp_error(state, "unknown command %s", arg);
+        }
         break;
     case ARGP_KEY_END:
+        if (arguments->follow)
+        {
+            /* the scrolling region must fit on the display */
+            const int first = (arguments->line != 0xff) ? arguments->line : 0;
+            if (arguments->rows == 0 || first + arguments->rows > VARIKEY_SNAPSHOT_LINES)
+            {
+                argp_error(state, "%d rows from line %d exceed the %d display lines",
+                           arguments->rows, first, VARIKEY_SNAPSHOT_LINES);
+            }
+        }
         break;
     default:
         return ARGP_ERR_UNKNOWN;
@@ -111,7 +215,8 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 }
 
 static char doc[] = "gadget controller";
-static struct argp argp = {options, parse_opt, 0, doc, 0, 0, 0};
+static char args_doc[] = "[probe]";
+static struct argp argp = {options, parse_opt, args_doc, doc, 0, 0, 0};
 
 /**
  * @brief set argument defaults
@@ -123,6 +228,7 @@ extern void wizard_arguments_init(wizard::arguments &arguments)
     arguments.device = nullptr;
     arguments.verbose = false;
     arguments.unique = 0;
+    arguments.unique_count = 0;
     arguments.list = false;
     arguments.reset = false;
     arguments.line = 0xff;
@@ -132,6 +238,27 @@ extern void wizard_arguments_init(wizard::arguments &arguments)
     arguments.text = nullptr;
     arguments.temperature = false;
     arguments.backlight = 0xff;
+    arguments.dashboard = nullptr;
+    arguments.interval = 100;
+    arguments.board = false;
+    arguments.post = false;
+    arguments.follow = false;
+    arguments.rows = 1;
+    arguments.realtime = -1;
+    arguments.cpu = -1;
+    arguments.jitter = 0;
+    arguments.probe = false;
+    arguments.count = 100;
+    arguments.binding = nullptr;
+    arguments.events = false;
+    arguments.accelerate = false;
+    arguments.group = false;
+    arguments.timeout = 0;
+    arguments.marquee = 0;
+    arguments.loopback = nullptr;
+    arguments.animation = nullptr;
+    arguments.once = false;
+    arguments.trace = nullptr;
 }
 
 extern void wizard_arguments_parse(wizard::arguments &arguments, int argc, char *argv[])
@@ -11,12 +11,16 @@
 
 #include <cstdint>
 
+#define WIZARD_UNIQUE_LIMIT 32
+
 namespace wizard
 {
     struct arguments
     {
         const char *device; /* wizard device */
         uint32_t unique;    /* unique identifier */
+        uint32_t uniques[WIZARD_UNIQUE_LIMIT]; /* all given unique identifiers */
+        uint8_t unique_count;                 /* number of unique identifiers */
         bool verbose;       /* verbose flag */
         bool list;          /* devices list */
         bool reset;         /* reset flag */
@@ -30,6 +34,27 @@ namespace wizard
         uint8_t r_value;    /* set backlight red channel */
         uint8_t g_value;    /* set backlight green channel */
         uint8_t b_value;    /* set backlight blue channel */
+        char *dashboard;    /* dashboard template */
+        uint32_t interval;  /* update interval in milliseconds */
+        bool board;         /* serve status board */
+        bool post;          /* post to status board */
+        bool follow;        /* stream input lines to gadget */
+        uint8_t rows;       /* scrolling region rows */
+        int realtime;       /* real-time priority, -1 disabled */
+        int cpu;            /* cpu affinity, -1 all cpus */
+        uint32_t jitter;    /* jitter report cycles */
+        bool probe;         /* probe subcommand */
+        uint32_t count;     /* probe iterations */
+        char *binding;      /* key binding table */
+        bool events;        /* show input events */
+        bool accelerate;    /* encoder acceleration */
+        bool group;         /* synchronized group execution */
+        uint32_t timeout;   /* gadget operation deadline in milliseconds, 0 unlimited */
+        uint32_t marquee;   /* ticker step in milliseconds, 0 disabled */
+        char *loopback;     /* loopback gadgets COUNT[:LATENCY[:JITTER[:ERRORS[:VERSION]]]] */
+        char *animation;    /* icon sequence ICON:MS[,ICON:MS...] */
+        bool once;          /* play the icon sequence once */
+        char *trace;        /* chrome trace output file */
     };
 }
 
@@ -0,0 +1,479 @@
+/**
+ * \file wizard_dashboard.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wizard_dashboard.hpp"
+
+/**
+ * \brief longest text pushed to a display line
+ *
+ * one byte of the payload is kept free for the terminating zero
+ * @{
+ */
+#define DASHBOARD_TEXT_SIZE (VARIKEY_TEXT_SIZE - 1)
+/** }@ */
+
+static bool parse_color(const std::string &, uint8_t rgb[3]);
+static void strip_line(std::string &);
+
+namespace wizard
+{
+	dashboard::dashboard() {}
+
+	dashboard::~dashboard()
+	{
+		for (auto &i : sources)
+		{
+			if (i.fifo_handle >= 0)
+			{
+				close(i.fifo_handle);
+				i.fifo_handle = -1;
+			}
+			if (i.command_pipe != nullptr)
+			{
+				pclose(i.command_pipe);
+				i.command_pipe = nullptr;
+			}
+		}
+	}
+
+	/**
+	 * \brief load and compile dashboard template
+	 *
+	 * @param _template_path template file
+	 * @return true if the whole template is valid
+	 */
+	bool dashboard::load(const char *_template_path)
+	{
+		std::ifstream input(_template_path);
+		if (!input.is_open())
+		{
+			std::cerr << "unable to open dashboard template " << _template_path << std::endl;
+			return false;
+		}
+
+		std::string line;
+		size_t line_number = 0;
+		while (std::getline(input, line))
+		{
+			++line_number;
+			if (!parse_line(line))
+			{
+				std::cerr << _template_path << ":" << line_number << ": invalid dashboard field" << std::endl;
+				return false;
+			}
+		}
+
+		invalidate();
+		return fields.size() > 0;
+	}
+
+	/**
+	 * \brief force full redraw on the next update
+	 */
+	void dashboard::invalidate()
+	{
+		current_font_size = 0xff;
+		for (auto &i : fields)
+		{
+			i.dirty = true;
+		}
+		for (auto &i : sources)
+		{
+			i.size = -1;
+		}
+	}
+
+	/**
+	 * \brief poll all data sources and push changed fields only
+	 *
+	 * @param _gadget open gadget
+	 * @return size_t number of pushed fields
+	 */
+	size_t dashboard::update(varikey::gadget::usb &_gadget)
+	{
+		for (auto &i : sources)
+		{
+			i.changed = poll_source(i, _gadget);
+		}
+
+		size_t pushed = 0;
+		for (auto &i : fields)
+		{
+			source &origin = sources[i.source_index];
+			if (!(i.dirty || origin.changed))
+			{
+				continue;
+			}
+
+			if (push_field(i, origin.value, _gadget))
+			{
+				++pushed;
+			}
+
+			if (!_gadget.is_open())
+			{
+				break;
+			}
+		}
+
+		return pushed;
+	}
+
+	bool dashboard::parse_line(const std::string &_line)
+	{
+		std::istringstream tokens(_line);
+		std::string keyword;
+		if (!(tokens >> keyword) || keyword[0] == '#')
+		{
+			return true;
+		}
+
+		field item;
+		if (keyword == "text")
+		{
+			int line, column, font_size;
+			if (!(tokens >> line >> column >> font_size))
+			{
+				return false;
+			}
+			item.type = field_type::TEXT;
+			item.line = static_cast<uint8_t>(line);
+			item.column = static_cast<uint8_t>(column);
+			item.font_size = static_cast<uint8_t>(font_size);
+		}
+		else if (keyword == "icon")
+		{
+			item.type = field_type::ICON;
+		}
+		else if (keyword == "backlight")
+		{
+			std::string above, below;
+			if (!(tokens >> item.threshold >> above >> below) ||
+				!parse_color(above, item.above) || !parse_color(below, item.below))
+			{
+				return false;
+			}
+			item.type = field_type::BACKLIGHT;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (!parse_source(tokens, item.source_index))
+		{
+			return false;
+		}
+
+		fields.push_back(item);
+		return true;
+	}
+
+	/**
+	 * \brief parse field source, equal sources are shared between fields
+	 */
+	bool dashboard::parse_source(std::istringstream &_tokens, size_t &_source_index)
+	{
+		std::string keyword;
+		if (!(_tokens >> keyword))
+		{
+			return false;
+		}
+
+		std::string argument;
+		std::getline(_tokens >> std::ws, argument);
+		strip_line(argument);
+
+		source item;
+		if (keyword == "file")
+		{
+			item.type = source_type::FILE;
+		}
+		else if (keyword == "fifo")
+		{
+			item.type = source_type::FIFO;
+		}
+		else if (keyword == "command")
+		{
+			item.type = source_type::COMMAND;
+		}
+		else if (keyword == "temperature")
+		{
+			item.type = source_type::TEMPERATURE;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (item.type != source_type::TEMPERATURE && argument.empty())
+		{
+			return false;
+		}
+		item.argument = argument;
+
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			if (sources[i].type == item.type && sources[i].argument == item.argument)
+			{
+				_source_index = i;
+				return true;
+			}
+		}
+
+		if (item.type == source_type::FIFO)
+		{
+			item.fifo_handle = open(item.argument.c_str(), O_RDONLY | O_NONBLOCK);
+			if (item.fifo_handle < 0)
+			{
+				fprintf(stderr, "unable to open fifo %s: %d %s\n", item.argument.c_str(), errno, strerror(errno));
+				return false;
+			}
+		}
+
+		_source_index = sources.size();
+		sources.push_back(item);
+		return true;
+	}
+
+	/**
+	 * \brief read source value
+	 *
+	 * @return true if the value differs from the previous one
+	 */
+	bool dashboard::poll_source(source &_source, varikey::gadget::usb &_gadget)
+	{
+		std::string value;
+
+		switch (_source.type)
+		{
+		case source_type::FILE:
+		{
+			struct stat status;
+			if (stat(_source.argument.c_str(), &status) < 0)
+			{
+				return false;
+			}
+			if (status.st_size == _source.size &&
+				status.st_mtim.tv_sec == _source.modified.tv_sec &&
+				status.st_mtim.tv_nsec == _source.modified.tv_nsec)
+			{
+				return false;
+			}
+			_source.size = status.st_size;
+			_source.modified = status.st_mtim;
+
+			std::ifstream input(_source.argument);
+			std::getline(input, value);
+		}
+		break;
+		case source_type::FIFO:
+		{
+			char buffer[256];
+			ssize_t length;
+			while ((length = read(_source.fifo_handle, buffer, sizeof(buffer))) > 0)
+			{
+				_source.fifo_buffer.append(buffer, length);
+			}
+
+			/* latest complete line wins */
+			size_t end = _source.fifo_buffer.rfind('\n');
+			if (end == std::string::npos)
+			{
+				return false;
+			}
+			size_t begin = _source.fifo_buffer.rfind('\n', end == 0 ? 0 : end - 1);
+			begin = (begin == std::string::npos || begin == end) ? 0 : begin + 1;
+			value = _source.fifo_buffer.substr(begin, end - begin);
+			_source.fifo_buffer.erase(0, end + 1);
+		}
+		break;
+		case source_type::COMMAND:
+		{
+			/* start the command and collect its output over the next updates */
+			if (_source.command_pipe == nullptr)
+			{
+				_source.command_pipe = popen(_source.argument.c_str(), "r");
+				if (_source.command_pipe == nullptr)
+				{
+					return false;
+				}
+				const int handle = fileno(_source.command_pipe);
+				fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+				_source.command_output.clear();
+			}
+
+			char buffer[256];
+			ssize_t length;
+			while ((length = read(fileno(_source.command_pipe), buffer, sizeof(buffer))) > 0)
+			{
+				if (_source.command_output.length() < sizeof(buffer))
+				{
+					_source.command_output.append(buffer, length);
+				}
+			}
+			if (length < 0)
+			{
+				/* still running */
+				return false;
+			}
+
+			pclose(_source.command_pipe);
+			_source.command_pipe = nullptr;
+			value = _source.command_output.substr(0, _source.command_output.find('\n'));
+		}
+		break;
+		case source_type::TEMPERATURE:
+		{
+			float temperature = 0;
+			if (_gadget.get_temperature(temperature) != varikey::gadget::status::SUCCESS)
+			{
+				return false;
+			}
+			char buffer[16];
+			snprintf(buffer, sizeof(buffer), "%.1f", temperature);
+			value = buffer;
+		}
+		break;
+		}
+
+		strip_line(value);
+		if (value == _source.value)
+		{
+			return false;
+		}
+
+		_source.value = value;
+		return true;
+	}
+
+	/**
+	 * \brief push field value to the gadget if the rendered result changed
+	 *
+	 * the field counts as shown only once the gadget took it
+	 *
+	 * @return true if reports have been sent
+	 */
+	bool dashboard::push_field(field &_field, const std::string &_value, varikey::gadget::usb &_gadget)
+	{
+		std::string rendered;
+
+		switch (_field.type)
+		{
+		case field_type::TEXT:
+			rendered = _value.substr(0, DASHBOARD_TEXT_SIZE);
+			break;
+		case field_type::ICON:
+			rendered = std::to_string(std::atoi(_value.c_str()));
+			break;
+		case field_type::BACKLIGHT:
+			rendered = (std::atof(_value.c_str()) >= _field.threshold) ? "above" : "below";
+			break;
+		}
+
+		if (!_field.dirty && rendered == _field.rendered)
+		{
+			return false;
+		}
+
+		varikey::gadget::status result = varikey::gadget::status::SUCCESS;
+		switch (_field.type)
+		{
+		case field_type::TEXT:
+		{
+			/* overwrite the rest of a longer previous text */
+			std::string text = rendered;
+			if (text.length() < _field.rendered.length())
+			{
+				text.append(_field.rendered.length() - text.length(), ' ');
+			}
+
+			varikey::command commands[3];
+			size_t count = 0;
+			if (_field.font_size != current_font_size)
+			{
+				commands[count++] = varikey::encode_font_size(_field.font_size);
+			}
+			commands[count++] = varikey::encode_position(_field.line, _field.column);
+			commands[count++] = varikey::encode_text(text);
+			result = _gadget.send_commands(commands, count);
+			if (result == varikey::gadget::status::SUCCESS)
+			{
+				current_font_size = _field.font_size;
+			}
+		}
+		break;
+		case field_type::ICON:
+			result = _gadget.draw_icon(std::atoi(rendered.c_str()));
+			break;
+		case field_type::BACKLIGHT:
+		{
+			const uint8_t *rgb = (rendered == "above") ? _field.above : _field.below;
+			result = _gadget.set_backlight_color(rgb[0], rgb[1], rgb[2]);
+		}
+		break;
+		}
+
+		if (result != varikey::gadget::status::SUCCESS)
+		{
+			/* retried on the next update, the gadget state is unknown */
+			_field.dirty = true;
+			current_font_size = 0xff;
+			return false;
+		}
+
+		_field.rendered = rendered;
+		_field.dirty = false;
+		return true;
+	}
+}
+
+/**
+ * \brief parse hex RRGGBB color
+ */
+static bool parse_color(const std::string &_color, uint8_t _rgb[3])
+{
+	if (_color.length() != 6)
+	{
+		return false;
+	}
+
+	char *end = nullptr;
+	unsigned long value = strtoul(_color.c_str(), &end, 16);
+	if (end == nullptr || *end != '\0')
+	{
+		return false;
+	}
+
+	_rgb[0] = static_cast<uint8_t>((value >> 16) & 0xff);
+	_rgb[1] = static_cast<uint8_t>((value >> 8) & 0xff);
+	_rgb[2] = static_cast<uint8_t>(value & 0xff);
+	return true;
+}
+
+/**
+ * \brief remove trailing line break and blanks
+ */
+static void strip_line(std::string &_line)
+{
+	while (!_line.empty() && (_line.back() == '\n' || _line.back() == '\r' || _line.back() == ' ' || _line.back() == '\t'))
+	{
+		_line.pop_back();
+	}
+}
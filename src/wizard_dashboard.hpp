@@ -0,0 +1,113 @@
+/**
+ * \file wizard_dashboard.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIZARD_DASHBOARD_HPP__
+#define __WIZARD_DASHBOARD_HPP__
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "varikey_gadget_usb.hpp"
+
+namespace wizard
+{
+	/**
+	 * \brief declarative gadget screen
+	 *
+	 * A dashboard template describes the screen layout line by line.
+	 * Every field ends with a data source and its optional argument:
+	 *
+	 *   # comment
+	 *   text LINE COLUMN FONT SOURCE [ARGUMENT]
+	 *   icon SOURCE [ARGUMENT]
+	 *   backlight THRESHOLD RRGGBB RRGGBB SOURCE [ARGUMENT]
+	 *
+	 * Sources are "file PATH", "fifo PATH", "command SHELL COMMAND" and
+	 * "temperature". A backlight field uses the first color when the
+	 * source value reaches the threshold and the second one otherwise.
+	 *
+	 * Sources are polled on every update, but only the fields whose
+	 * rendered value changed are pushed to the gadget. A command runs in
+	 * the background, its first output line becomes the value once it
+	 * exits and the next update starts it again.
+	 */
+	class dashboard
+	{
+	public:
+		dashboard();
+		virtual ~dashboard();
+
+		bool load(const char *template_path);
+		size_t update(varikey::gadget::usb &);
+		void invalidate();
+
+		size_t field_count() const { return fields.size(); }
+
+	private:
+		enum class source_type
+		{
+			FILE,
+			FIFO,
+			COMMAND,
+			TEMPERATURE,
+		};
+
+		enum class field_type
+		{
+			TEXT,
+			ICON,
+			BACKLIGHT,
+		};
+
+		struct source
+		{
+			source_type type;
+			std::string argument;
+			int fifo_handle{-1};
+			std::string fifo_buffer;
+			FILE *command_pipe{nullptr}; /* running command, read without blocking */
+			std::string command_output;
+			struct timespec modified{};
+			off_t size{-1};
+			std::string value;
+			bool changed{false};
+		};
+
+		struct field
+		{
+			field_type type;
+			uint8_t line{0};
+			uint8_t column{0};
+			uint8_t font_size{0};
+			float threshold{0};
+			uint8_t above[3]{};
+			uint8_t below[3]{};
+			size_t source_index{0};
+			std::string rendered;
+			bool dirty{true};
+		};
+
+		bool parse_line(const std::string &);
+		bool parse_source(std::istringstream &, size_t &source_index);
+
+		bool poll_source(source &, varikey::gadget::usb &);
+		bool push_field(field &, const std::string &value, varikey::gadget::usb &);
+
+		std::vector<source> sources;
+		std::vector<field> fields;
+
+		uint8_t current_font_size{0xff};
+	};
+}
+
+#endif // __WIZARD_DASHBOARD_HPP__
@@ -0,0 +1,235 @@
+/**
+ * \file wizard_follow.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+#include "wizard_follow.hpp"
+
+/**
+ * \brief follow mode parameters
+ * @{
+ */
+#define FOLLOW_TEXT_SIZE (VARIKEY_TEXT_SIZE - 1)
+#define FOLLOW_POLL_TIMEOUT 100 /* ms */
+#define FOLLOW_CHUNK_SIZE 4096
+/** }@ */
+
+namespace wizard
+{
+	follow::follow(varikey::gadget::usb &_gadget, const uint8_t _line, const uint8_t _rows,
+				   const uint8_t _column, const uint8_t _font_size) : gadget(_gadget),
+																	   line(_line),
+																	   rows(_rows > 0 ? _rows : 1),
+																	   column(_column),
+																	   font_size(_font_size),
+																	   region(rows),
+																	   displayed(rows, 0)
+	{
+		/* all buffers are sized up front, rendering does not allocate */
+		slot.reserve(FOLLOW_TEXT_SIZE + 1);
+		pending.reserve(FOLLOW_CHUNK_SIZE);
+		for (auto &i : region)
+		{
+			i.reserve(FOLLOW_TEXT_SIZE + 1);
+		}
+	}
+
+	follow::~follow()
+	{
+		stopping = true;
+		if (reader.joinable())
+		{
+			reader.join();
+		}
+	}
+
+	/**
+	 * \brief render input lines until the input ends or running drops
+	 *
+	 * @param input_handle input file descriptor, usually stdin
+	 * @param running cleared by a signal handler to stop
+	 */
+	void follow::run(const int _input_handle, const volatile sig_atomic_t &_running)
+	{
+		if (font_size != 0xff)
+		{
+			gadget.set_font_size(font_size);
+		}
+
+		input_open = true;
+		reader = std::thread(&follow::read_input, this, _input_handle);
+
+		std::string text;
+		text.reserve(FOLLOW_TEXT_SIZE + 1);
+		while (_running && gadget.is_open())
+		{
+			{
+				std::unique_lock<std::mutex> lock(slot_lock);
+				slot_signal.wait_for(lock, std::chrono::milliseconds(FOLLOW_POLL_TIMEOUT),
+									 [this]
+									 { return slot_full || !input_open; });
+
+				if (!slot_full)
+				{
+					if (!input_open)
+					{
+						break;
+					}
+					continue;
+				}
+
+				text.swap(slot);
+				slot_full = false;
+			}
+
+			render(text);
+			++shown;
+		}
+
+		stopping = true;
+		reader.join();
+	}
+
+	/**
+	 * \brief drain input, keep the latest complete line only
+	 */
+	void follow::read_input(const int _input_handle)
+	{
+		char chunk[FOLLOW_CHUNK_SIZE];
+		struct pollfd input = {_input_handle, POLLIN, 0};
+
+		while (!stopping)
+		{
+			int ready = poll(&input, 1, FOLLOW_POLL_TIMEOUT);
+			if (ready < 0 && errno != EINTR)
+			{
+				break;
+			}
+			if (ready <= 0)
+			{
+				continue;
+			}
+
+			ssize_t length = read(_input_handle, chunk, sizeof(chunk));
+			if (length <= 0)
+			{
+				if (length < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				break;
+			}
+
+			/* find the last complete line of the chunk, earlier ones are dropped */
+			const char *end = chunk + length;
+			const char *last_end = nullptr;
+			uint64_t lines = 0;
+			for (const char *i = chunk; i < end; ++i)
+			{
+				if (*i == '\n')
+				{
+					last_end = i;
+					++lines;
+				}
+			}
+
+			if (last_end == nullptr)
+			{
+				append_pending(chunk, length);
+				continue;
+			}
+
+			const char *last_begin = static_cast<const char *>(memrchr(chunk, '\n', last_end - chunk));
+			if (last_begin == nullptr)
+			{
+				append_pending(chunk, last_end - chunk);
+				publish(pending.data(), pending.data() + pending.length(), lines - 1);
+			}
+			else
+			{
+				publish(last_begin + 1, last_end, lines - 1);
+			}
+
+			pending.clear();
+			append_pending(last_end + 1, end - last_end - 1);
+		}
+
+		if (!pending.empty())
+		{
+			publish(pending.data(), pending.data() + pending.length(), 0);
+			pending.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(slot_lock);
+		input_open = false;
+		slot_signal.notify_one();
+	}
+
+	/**
+	 * \brief collect a partial line, overlong lines are cut
+	 */
+	void follow::append_pending(const char *_data, const size_t _length)
+	{
+		pending.append(_data, std::min(_length, pending.capacity() - pending.length()));
+	}
+
+	/**
+	 * \brief replace the pending line, latest wins
+	 */
+	void follow::publish(const char *_begin, const char *_end, const uint64_t _skipped)
+	{
+		if (_end > _begin && *(_end - 1) == '\r')
+		{
+			--_end;
+		}
+
+		std::lock_guard<std::mutex> lock(slot_lock);
+		received += _skipped + 1;
+		dropped += _skipped + (slot_full ? 1 : 0);
+		slot.assign(_begin, std::min<size_t>(_end - _begin, FOLLOW_TEXT_SIZE));
+		slot_full = true;
+		slot_signal.notify_one();
+	}
+
+	/**
+	 * \brief show text on the line or scroll it into the region
+	 */
+	void follow::render(const std::string &_text)
+	{
+		for (size_t i = 1; i < region.size(); ++i)
+		{
+			region[i - 1].swap(region[i]);
+		}
+		region.back() = _text;
+
+		for (size_t i = 0; i < region.size() && gadget.is_open(); ++i)
+		{
+			/* the last row always changes, upper rows only while scrolling */
+			if (i + 1 < region.size() && region[i].empty() && displayed[i] == 0)
+			{
+				continue;
+			}
+
+			char text[VARIKEY_TEXT_SIZE];
+			const size_t length = region[i].length();
+			memcpy(text, region[i].data(), length);
+			memset(text + length, ' ', (displayed[i] > length) ? displayed[i] - length : 0);
+			text[std::max(length, displayed[i])] = '\0';
+
+			varikey::command commands[] = {varikey::encode_position(line + i, column),
+										   varikey::encode_text(text)};
+			gadget.send_commands(commands, 2);
+			displayed[i] = region[i].length();
+		}
+	}
+}
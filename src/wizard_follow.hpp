@@ -0,0 +1,76 @@
+/**
+ * \file wizard_follow.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIZARD_FOLLOW_HPP__
+#define __WIZARD_FOLLOW_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "varikey_gadget_usb.hpp"
+
+namespace wizard
+{
+	/**
+	 * \brief stream input lines to a gadget display
+	 *
+	 * A reader thread drains the input without ever blocking upstream and
+	 * keeps only the latest complete line. The renderer shows it on one
+	 * display line or scrolls it into a region of several lines. Lines
+	 * replaced before the gadget could take them are counted as dropped.
+	 */
+	class follow
+	{
+	public:
+		follow(varikey::gadget::usb &, const uint8_t line, const uint8_t rows,
+			   const uint8_t column, const uint8_t font_size);
+		virtual ~follow();
+
+		void run(const int input_handle, const volatile sig_atomic_t &running);
+
+		uint64_t get_received() const { return received; }
+		uint64_t get_shown() const { return shown; }
+		uint64_t get_dropped() const { return dropped; }
+
+	private:
+		void read_input(const int input_handle);
+		void append_pending(const char *data, const size_t length);
+		void publish(const char *begin, const char *end, const uint64_t skipped);
+		void render(const std::string &);
+
+		varikey::gadget::usb &gadget;
+		const uint8_t line;
+		const uint8_t rows;
+		const uint8_t column;
+		const uint8_t font_size;
+
+		std::thread reader;
+		std::mutex slot_lock;
+		std::condition_variable slot_signal;
+		std::string slot;
+		bool slot_full{false};
+		std::string pending;
+		std::atomic<bool> input_open{false};
+		std::atomic<bool> stopping{false};
+
+		std::vector<std::string> region;
+		std::vector<size_t> displayed;
+
+		std::atomic<uint64_t> received{0};
+		uint64_t shown{0};
+		std::atomic<uint64_t> dropped{0};
+	};
+}
+
+#endif // __WIZARD_FOLLOW_HPP__
@@ -0,0 +1,249 @@
+/**
+ * \file wizard_probe.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#include "varikey_allocation.hpp"
+#include "varikey_gadget_handle.hpp"
+#include "varikey_rate.hpp"
+#include "wizard_probe.hpp"
+
+namespace wizard
+{
+	probe::probe(wizard::usb &_devices, const uint32_t _count) : devices(_devices), count(_count) {}
+
+	/**
+	 * \brief probe all gadgets in parallel
+	 *
+	 * @param uniques unique identifiers of the probed gadgets
+	 */
+	void probe::run(const std::vector<uint32_t> &_uniques)
+	{
+		results.clear();
+		results.resize(_uniques.size());
+		for (size_t i = 0; i < _uniques.size(); ++i)
+		{
+			results[i].unique = _uniques[i];
+			results[i].feature.reserve(count);
+			results[i].output.reserve(count);
+			results[i].update.reserve(count);
+		}
+
+		std::vector<std::thread> workers;
+		for (auto &i : results)
+		{
+			workers.emplace_back(&probe::measure, this, std::ref(i));
+		}
+		for (auto &i : workers)
+		{
+			i.join();
+		}
+	}
+
+	/**
+	 * \brief probe one gadget, feature reads first, then output reports
+	 */
+	void probe::measure(result &_result)
+	{
+		varikey::gadget::usb &gadget = devices.open_device(_result.unique);
+		if (!(gadget.is_valid() && gadget.is_open()))
+		{
+			return;
+		}
+		_result.valid = true;
+
+		/* the probe measures the gadget, not the rate limit */
+		gadget.set_rate_policy(varikey::rate_controller::policy::NONE);
+
+		varikey::allocation::scope feature_scope;
+		for (uint32_t i = 0; i < count && gadget.is_open(); ++i)
+		{
+			const uint64_t start = varikey::rate_controller::now();
+			float value = 0;
+			const varikey::gadget::status status = gadget.get_temperature(value);
+			const uint64_t end = varikey::rate_controller::now();
+
+			if (status == varikey::gadget::status::TIMEOUT || status == varikey::gadget::status::BUSY)
+			{
+				++_result.feature_timeouts;
+			}
+			else if (status != varikey::gadget::status::SUCCESS)
+			{
+				++_result.feature_errors;
+			}
+			else
+			{
+				_result.feature.push_back(end - start);
+			}
+		}
+
+		_result.feature_allocations = feature_scope.get();
+
+		/* gadgets without backlight or display have no output report to time */
+		const uint8_t capabilities = gadget.get_capabilities();
+		_result.output_supported = capabilities != varikey::gadget::CAPABILITY_NONE;
+		_result.update_supported = capabilities & varikey::gadget::CAPABILITY_DISPLAY;
+
+		/* samples are reserved up front, the loop itself must not allocate */
+		varikey::allocation::scope output_scope;
+		const uint64_t begin = varikey::rate_controller::now();
+		for (uint32_t i = 0; i < count && _result.output_supported && gadget.is_open(); ++i)
+		{
+			const uint64_t start = varikey::rate_controller::now();
+			const varikey::gadget::status status = output_report(gadget, capabilities);
+			const uint64_t end = varikey::rate_controller::now();
+
+			if (status == varikey::gadget::status::SUCCESS)
+			{
+				_result.output.push_back(end - start);
+			}
+			else if (status == varikey::gadget::status::TIMEOUT || status == varikey::gadget::status::BUSY)
+			{
+				++_result.output_timeouts;
+			}
+			else
+			{
+				++_result.output_errors;
+			}
+		}
+		_result.output_duration = varikey::rate_controller::now() - begin;
+		_result.output_allocations = output_scope.get();
+
+		/* a three command text update, one report with compound support */
+		_result.compound = gadget.supports_compound();
+		varikey::command update[] = {varikey::encode_position(0, 0), varikey::encode_font_size(0),
+									 varikey::encode_text("probe")};
+		varikey::allocation::scope update_scope;
+		for (uint32_t i = 0; i < count && _result.update_supported && gadget.is_open(); ++i)
+		{
+			const uint64_t start = varikey::rate_controller::now();
+			const varikey::gadget::status status = gadget.send_commands(update, 3);
+			const uint64_t end = varikey::rate_controller::now();
+
+			if (status == varikey::gadget::status::SUCCESS)
+			{
+				_result.update.push_back(end - start);
+			}
+			else if (status == varikey::gadget::status::TIMEOUT || status == varikey::gadget::status::BUSY)
+			{
+				++_result.update_timeouts;
+			}
+			else
+			{
+				++_result.update_errors;
+			}
+		}
+		_result.update_allocations = update_scope.get();
+
+		gadget.set_rate_policy(varikey::rate_controller::policy::HOLD);
+		devices.close_device(gadget);
+	}
+
+	/**
+	 * \brief one output report the gadget supports, the cursor position on
+	 * displays, the backlight color (off) on backlight only gadgets
+	 */
+	varikey::gadget::status probe::output_report(varikey::gadget::usb &_gadget, const uint8_t _capabilities)
+	{
+		if (_capabilities & varikey::gadget::CAPABILITY_DISPLAY)
+		{
+			return varikey::gadget::display_handle(_gadget).set_position(0, 0);
+		}
+		else if (_capabilities & varikey::gadget::CAPABILITY_BACKLIGHT)
+		{
+			return varikey::gadget::backlight_handle(_gadget).set_backlight_color(0, 0, 0);
+		}
+		return varikey::gadget::status::UNSUPPORTED;
+	}
+
+	/**
+	 * \brief print latency percentiles, errors and output rate per gadget
+	 */
+	void probe::print() const
+	{
+		for (auto const &i : results)
+		{
+			if (!i.valid)
+			{
+				printf("device %u invalid\n", i.unique);
+				continue;
+			}
+
+			printf("device %u%s\n", i.unique, i.compound ? " compound" : "");
+			print_samples("feature", i.feature);
+			if (i.output_supported)
+			{
+				print_samples("output", i.output);
+			}
+			else
+			{
+				printf("  %-8s unsupported\n", "output");
+			}
+			if (i.update_supported)
+			{
+				print_samples("update", i.update);
+			}
+			else
+			{
+				printf("  %-8s unsupported\n", "update");
+			}
+			printf("  errors feature %u output %u update %u\n", i.feature_errors, i.output_errors, i.update_errors);
+			if (i.feature_timeouts + i.output_timeouts + i.update_timeouts > 0)
+			{
+				printf("  timeouts feature %u output %u update %u\n",
+					   i.feature_timeouts, i.output_timeouts, i.update_timeouts);
+			}
+			if (varikey::allocation::enabled())
+			{
+				printf("  allocations feature %llu output %llu update %llu\n",
+					   static_cast<unsigned long long>(i.feature_allocations),
+					   static_cast<unsigned long long>(i.output_allocations),
+					   static_cast<unsigned long long>(i.update_allocations));
+			}
+			if (i.output_supported && i.output_duration > 0)
+			{
+				printf("  output %.1f reports/s\n", i.output.size() * 1e9 / i.output_duration);
+			}
+		}
+	}
+
+	/**
+	 * \brief allocations inside the measured loops of all gadgets, 0
+	 * without allocation counting
+	 */
+	uint64_t probe::get_allocations() const
+	{
+		uint64_t allocations = 0;
+		for (auto const &i : results)
+		{
+			allocations += i.feature_allocations + i.output_allocations + i.update_allocations;
+		}
+		return allocations;
+	}
+
+	void probe::print_samples(const char *_name, std::vector<uint64_t> _samples)
+	{
+		if (_samples.empty())
+		{
+			printf("  %-8s no samples\n", _name);
+			return;
+		}
+
+		std::sort(_samples.begin(), _samples.end());
+		auto percentile = [&_samples](const size_t p)
+		{
+			return _samples[std::min(_samples.size() - 1, (_samples.size() * p) / 100)] / 1000.0;
+		};
+
+		printf("  %-8s us min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f (%zu)\n", _name,
+			   _samples.front() / 1000.0, percentile(50), percentile(90), percentile(99),
+			   _samples.back() / 1000.0, _samples.size());
+	}
+}
@@ -0,0 +1,71 @@
+/**
+ * \file wizard_probe.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIZARD_PROBE_HPP__
+#define __WIZARD_PROBE_HPP__
+
+#include <cstdint>
+#include <vector>
+
+#include "wizard_usb.hpp"
+
+namespace wizard
+{
+	/**
+	 * \brief round trip latency probe
+	 *
+	 * Times repeated TEMPERATURE feature reads, output reports and text
+	 * updates (position, font, text) on every probed gadget; updates are
+	 * compound reports where the firmware has them. Gadgets are probed in
+	 * parallel, one thread each, so a slow hub branch stands out against
+	 * its siblings.
+	 */
+	class probe
+	{
+	public:
+		probe(wizard::usb &, const uint32_t count);
+		virtual ~probe() {}
+
+		void run(const std::vector<uint32_t> &uniques);
+		void print() const;
+		uint64_t get_allocations() const;
+
+	private:
+		struct result
+		{
+			uint32_t unique{0};
+			bool valid{false};
+			std::vector<uint64_t> feature;
+			std::vector<uint64_t> output;
+			std::vector<uint64_t> update;
+			bool compound{false};
+			bool output_supported{false};
+			bool update_supported{false};
+			uint32_t feature_errors{0};
+			uint32_t output_errors{0};
+			uint32_t update_errors{0};
+			uint32_t feature_timeouts{0};
+			uint32_t output_timeouts{0};
+			uint32_t update_timeouts{0};
+			uint64_t feature_allocations{0};
+			uint64_t output_allocations{0};
+			uint64_t update_allocations{0};
+			uint64_t output_duration{0};
+		};
+
+		void measure(result &);
+		static varikey::gadget::status output_report(varikey::gadget::usb &, const uint8_t capabilities);
+		static void print_samples(const char *name, std::vector<uint64_t> samples);
+
+		wizard::usb &devices;
+		const uint32_t count;
+		std::vector<result> results;
+	};
+}
+
+#endif // __WIZARD_PROBE_HPP__
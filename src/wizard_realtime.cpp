@@ -0,0 +1,183 @@
+/**
+ * \file wizard_realtime.cpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "varikey_rate.hpp"
+#include "wizard_realtime.hpp"
+
+/**
+ * \brief stack reserve touched before the real-time part starts
+ * @{
+ */
+#define REALTIME_STACK_PREFAULT (512 * 1024)
+/** }@ */
+
+static void prefault_stack();
+
+namespace wizard
+{
+	namespace realtime
+	{
+		/**
+		 * \brief switch the process into real-time mode
+		 *
+		 * @param setup scheduling parameters
+		 * @return true if every requested step succeeded
+		 */
+		bool enter(const setup &_setup)
+		{
+			bool result = true;
+
+			/* freed memory stays mapped and locked, no mmap for large blocks */
+			mallopt(M_TRIM_THRESHOLD, -1);
+			mallopt(M_MMAP_MAX, 0);
+
+			if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+			{
+				fprintf(stderr, "error locking memory: %d %s\n", errno, strerror(errno));
+				result = false;
+			}
+
+			prefault_stack();
+
+			if (_setup.cpu >= 0)
+			{
+				cpu_set_t cpus;
+				CPU_ZERO(&cpus);
+				CPU_SET(_setup.cpu, &cpus);
+				if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+				{
+					fprintf(stderr, "error setting cpu affinity: %d %s\n", errno, strerror(errno));
+					result = false;
+				}
+			}
+
+			if (_setup.priority > 0)
+			{
+				struct sched_param parameter = {};
+				parameter.sched_priority = std::min(_setup.priority, sched_get_priority_max(SCHED_FIFO));
+				if (sched_setscheduler(0, SCHED_FIFO, &parameter) < 0)
+				{
+					fprintf(stderr, "error setting fifo scheduler: %d %s\n", errno, strerror(errno));
+					result = false;
+				}
+			}
+
+			return result;
+		}
+
+		/**
+		 * \brief preallocate sample buffers
+		 *
+		 * @param cycles number of measurement cycles
+		 */
+		jitter::jitter(const uint32_t _cycles) : wakeup(_cycles), report(_cycles) {}
+
+		/**
+		 * \brief measure wakeup lateness and output report completion
+		 *
+		 * every cycle sleeps to an absolute deadline and sends one cursor
+		 * position report, nothing is allocated inside the loop
+		 *
+		 * @param gadget open gadget, host wakeups only without a gadget
+		 * @param interval cycle period in ns
+		 */
+		void jitter::measure(varikey::gadget::usb *_gadget, const uint64_t _interval)
+		{
+			uint64_t deadline = varikey::rate_controller::now();
+
+			if (_gadget == nullptr)
+			{
+				report.clear();
+			}
+
+			size_t cycles = 0;
+			for (; cycles < wakeup.size() && (_gadget == nullptr || _gadget->is_open()); ++cycles)
+			{
+				deadline += _interval;
+
+				struct timespec absolute;
+				absolute.tv_sec = deadline / 1000000000ULL;
+				absolute.tv_nsec = deadline % 1000000000ULL;
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &absolute, nullptr);
+
+				const uint64_t woken = varikey::rate_controller::now();
+				wakeup[cycles] = (woken > deadline) ? woken - deadline : 0;
+
+				if (_gadget != nullptr)
+				{
+					_gadget->set_position(0, 0);
+					report[cycles] = varikey::rate_controller::now() - woken;
+				}
+			}
+
+			wakeup.resize(cycles);
+			report.resize(std::min(report.size(), cycles));
+		}
+
+		/**
+		 * \brief print jitter report
+		 */
+		void jitter::print() const
+		{
+			if (wakeup.empty())
+			{
+				printf("no jitter samples\n");
+				return;
+			}
+
+			std::vector<uint64_t> samples(wakeup);
+			statistics value = evaluate(samples);
+			printf("cycles %zu\n", wakeup.size());
+			printf("wakeup us min %.1f p50 %.1f p99 %.1f max %.1f\n",
+				   value.minimum / 1000.0, value.median / 1000.0, value.p99 / 1000.0, value.maximum / 1000.0);
+
+			if (report.empty())
+			{
+				return;
+			}
+
+			samples = report;
+			value = evaluate(samples);
+			printf("report us min %.1f p50 %.1f p99 %.1f max %.1f\n",
+				   value.minimum / 1000.0, value.median / 1000.0, value.p99 / 1000.0, value.maximum / 1000.0);
+		}
+
+		statistics jitter::evaluate(std::vector<uint64_t> &_samples)
+		{
+			std::sort(_samples.begin(), _samples.end());
+
+			statistics value;
+			value.minimum = _samples.front();
+			value.median = _samples[_samples.size() / 2];
+			value.p99 = _samples[std::min(_samples.size() - 1, (_samples.size() * 99) / 100)];
+			value.maximum = _samples.back();
+			return value;
+		}
+	}
+}
+
+/**
+ * \brief touch the stack once, locked pages stay resident
+ */
+static void prefault_stack()
+{
+	volatile unsigned char reserve[REALTIME_STACK_PREFAULT];
+	for (size_t i = 0; i < sizeof(reserve); i += 4096)
+	{
+		reserve[i] = 0;
+	}
+}
@@ -0,0 +1,66 @@
+/**
+ * \file wizard_realtime.hpp
+ * \author Koch, Roman (koch.roman@gmail.com)
+ *
+ * Copyright (c) 2023, Roman Koch, koch.roman@gmail.com
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIZARD_REALTIME_HPP__
+#define __WIZARD_REALTIME_HPP__
+
+#include <cstdint>
+#include <vector>
+
+#include "varikey_gadget_usb.hpp"
+
+namespace wizard
+{
+	/**
+	 * \brief real-time run mode
+	 *
+	 * Locks all current and future pages, keeps freed heap memory in the
+	 * process and prefaults the stack, so no page fault happens after
+	 * startup. Optional SCHED_FIFO priority and CPU affinity remove
+	 * scheduler jitter. The jitter report verifies the result on a host.
+	 */
+	namespace realtime
+	{
+		struct setup
+		{
+			int priority; /* SCHED_FIFO priority, 0 keeps the default policy */
+			int cpu;	  /* cpu affinity, -1 keeps all cpus */
+		};
+
+		struct statistics
+		{
+			uint64_t minimum; /* ns */
+			uint64_t median;  /* ns */
+			uint64_t p99;	  /* ns */
+			uint64_t maximum; /* ns */
+		};
+
+		bool enter(const setup &);
+
+		/**
+		 * \brief periodic wakeup and report latency measurement
+		 */
+		class jitter
+		{
+		public:
+			jitter(const uint32_t cycles);
+			virtual ~jitter() {}
+
+			void measure(varikey::gadget::usb *, const uint64_t interval);
+			void print() const;
+
+		private:
+			static statistics evaluate(std::vector<uint64_t> &);
+
+			std::vector<uint64_t> wakeup;
+			std::vector<uint64_t> report;
+		};
+	}
+}
+
+#endif // __WIZARD_REALTIME_HPP__
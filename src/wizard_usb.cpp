@@ -8,7 +8,8 @@
 
 #include <cstdio>
 #include <iostream>
-#include <sstream>
+#include <cstring>
+#include <unistd.h>
 
 #include <linux/hiddev.h>
 #include <linux/hidraw.h>
@@ -16,6 +17,7 @@
 
 #include "varikey_command.hpp"
 #include "varikey_device.hpp"
+#include "varikey_trace.hpp"
 #include "wizard_usb.hpp"
 
 /**
@@ -30,10 +32,10 @@
 /** }@ */
 
 /**
- * @brief max number of expected hid devices for a scan
+ * @brief pause between two reconnect scans in milliseconds
  * @{
  */
-#define MAX_HID_NUMBER 16
+#define RECONNECT_INTERVAL 250
 /** }@ */
 
 namespace wizard
@@ -45,30 +47,82 @@ namespace wizard
 	/**
 	 * @brief open all devices with names corresponds to device pattern
 	 *
+	 * interfaces of a composite gadget are grouped by their usb port,
+	 * only the interface with feature reports is opened and probed, the
+	 * others are recorded as its input siblings
+	 *
 	 * @param _device_pattern example: /dev/hidraw for /dev/hidraw0... /dev/hidraw15
 	 * @return int number of devices
 	 */
 	int usb::scan_devices(const std::string &_device_pattern)
 	{
-		for (int i = 0; i < MAX_HID_NUMBER; ++i)
+		VARIKEY_TRACE("scan", 0);
+		strncpy(device_pattern, _device_pattern.c_str(), sizeof(device_pattern) - 1);
+
+		const size_t first = descriptor_count;
+		for (int i = 0; i < WIZARD_DEVICE_LIMIT && descriptor_count < WIZARD_DEVICE_LIMIT; ++i)
 		{
-			std::stringstream device_name;
-			device_name << _device_pattern << i;
+			device_descriptor &tmp = descriptor[descriptor_count];
+			snprintf(tmp.device_path, sizeof(tmp.device_path), "%s%d", device_pattern, i);
+			if (skip_node(tmp.device_path, tmp.location))
+			{
+				continue;
+			}
 
-			device_descriptor tmp;
-			tmp.device.usb_open(device_name.str().c_str());
+			tmp.device.set_transport(transport);
+			tmp.device.set_timeout(timeout);
+			tmp.device.usb_open(tmp.device_path);
 
 			if (tmp.device.is_open())
 			{
-				tmp.device_path = device_name.str();
 				tmp.device.usb_init();
 				tmp.device.usb_close();
 
-				descriptor.push_back(tmp);
+				/* without topology interfaces are grouped by the unique they
+				 * answer, a node without one cannot be assigned to a gadget */
+				if (tmp.location.port[0] == '\0')
+				{
+					if (!tmp.device.has_unique())
+					{
+						continue;
+					}
+
+					device_descriptor &known = const_cast<device_descriptor &>(find_valid_unique(tmp.device.get_unique()));
+					if (known.device.is_valid())
+					{
+						if (known.sibling_count < WIZARD_SIBLING_LIMIT)
+						{
+							memcpy(known.sibling_path[known.sibling_count++], tmp.device_path, sizeof(tmp.device_path));
+						}
+						continue;
+					}
+				}
+
+				tmp.sibling_count = 0;
+				++descriptor_count;
 			}
 		}
 
-		return descriptor.size();
+		for (size_t i = first; i < descriptor_count; ++i)
+		{
+			collect_siblings(descriptor[i]);
+		}
+
+		return descriptor_count;
+	}
+
+	/**
+	 * @brief deadline of every gadget operation, set before the scan
+	 *
+	 * @param _timeout timeout in ns, 0 blocks without limit
+	 */
+	void usb::set_timeout(const uint64_t _timeout)
+	{
+		timeout = _timeout;
+		for (size_t i = 0; i < descriptor_count; ++i)
+		{
+			descriptor[i].device.set_timeout(timeout);
+		}
 	}
 
 	/**
@@ -76,11 +130,12 @@ namespace wizard
 	 */
 	varikey::gadget::usb &usb::open_device(const uint32_t _unique)
 	{
+		VARIKEY_TRACE("open_device", _unique);
 		device_descriptor &descriptor = const_cast<device_descriptor &>(find_valid_unique(_unique));
 
 		if (descriptor.device.is_valid() && !descriptor.device.is_open())
 		{
-			descriptor.device.usb_open(descriptor.device_path.c_str());
+			descriptor.device.usb_open(descriptor.device_path);
 			if (descriptor.device.is_open())
 			{
 				return descriptor.device;
@@ -96,29 +151,160 @@ namespace wizard
 	 */
 	void usb::close_device(varikey::gadget::usb &_device)
 	{
+		VARIKEY_TRACE("close_device", _device.get_unique());
 		if (_device.is_valid() && _device.is_open())
 		{
 			_device.usb_close();
 		}
 	}
 
+	/**
+	 * @brief wait for a lost device to reappear and restore its state
+	 *
+	 * the device is found again by its unique identifier, its hidraw node
+	 * may have changed with a replug
+	 *
+	 * @param _device lost device
+	 * @param _timeout maximum wait in milliseconds
+	 * @return true if the device is open again
+	 */
+	bool usb::reconnect(varikey::gadget::usb &_device, const uint32_t _timeout)
+	{
+		VARIKEY_TRACE("reconnect", _device.get_unique());
+		if (!_device.is_valid() || device_pattern[0] == '\0')
+		{
+			return false;
+		}
+
+		const uint32_t unique = _device.get_unique();
+		uint32_t waited = 0;
+
+		for (;;)
+		{
+			for (int i = 0; i < WIZARD_DEVICE_LIMIT; ++i)
+			{
+				char device_name[VARIKEY_PATH_SIZE];
+				snprintf(device_name, sizeof(device_name), "%s%d", device_pattern, i);
+
+				varikey::topology::location location;
+				if (skip_node(device_name, location))
+				{
+					continue;
+				}
+
+				varikey::gadget::usb candidate;
+				candidate.set_transport(transport);
+				candidate.set_timeout(timeout);
+				candidate.usb_open(device_name);
+				if (!candidate.is_open())
+				{
+					continue;
+				}
+				candidate.usb_init();
+				candidate.usb_close();
+				if (candidate.get_unique() != unique)
+				{
+					continue;
+				}
+
+				/* the input interfaces may have moved with the control interface */
+				for (size_t j = 0; j < descriptor_count; ++j)
+				{
+					if (&descriptor[j].device == &_device)
+					{
+						memcpy(descriptor[j].device_path, device_name, sizeof(device_name));
+						descriptor[j].location = location;
+						collect_siblings(descriptor[j]);
+					}
+				}
+
+				_device.usb_open(device_name);
+				if (!_device.is_open())
+				{
+					continue;
+				}
+				_device.usb_init();
+
+				_device.restore();
+				return _device.is_open();
+			}
+
+			if (waited >= _timeout)
+			{
+				return false;
+			}
+			usleep(RECONNECT_INTERVAL * 1000);
+			waited += RECONNECT_INTERVAL;
+		}
+	}
+
+	/**
+	 * @brief nodes not worth opening: other vendors and input interfaces
+	 *
+	 * @param _device_path node path
+	 * @param _location filled from the topology, empty without
+	 * @return true if the node is skipped
+	 */
+	bool usb::skip_node(const char *_device_path, varikey::topology::location &_location) const
+	{
+		if (!transport->locate(_device_path, _location))
+		{
+			memset(&_location, 0, sizeof(_location));
+			return false;
+		}
+
+		return _location.vendor != VARIKEY_VENDOR_IDENTIFIER || _location.product != VARIKEY_PRODUCT_IDENTIFIER ||
+			   !_location.control;
+	}
+
+	/**
+	 * @brief record the input interfaces sharing the port of a device
+	 *
+	 * the gadget reads them beside its control interface from the next open
+	 */
+	void usb::collect_siblings(device_descriptor &_descriptor) const
+	{
+		if (_descriptor.location.port[0] == '\0')
+		{
+			/* without topology the scan recorded them */
+			_descriptor.device.set_inputs(_descriptor.sibling_path, _descriptor.sibling_count);
+			return;
+		}
+
+		_descriptor.sibling_count = 0;
+		for (int i = 0; i < WIZARD_DEVICE_LIMIT && _descriptor.sibling_count < WIZARD_SIBLING_LIMIT; ++i)
+		{
+			char device_name[VARIKEY_PATH_SIZE];
+			snprintf(device_name, sizeof(device_name), "%s%d", device_pattern, i);
+
+			varikey::topology::location location;
+			if (transport->locate(device_name, location) && !location.control &&
+				strcmp(location.port, _descriptor.location.port) == 0)
+			{
+				memcpy(_descriptor.sibling_path[_descriptor.sibling_count++], device_name, sizeof(device_name));
+			}
+		}
+		_descriptor.device.set_inputs(_descriptor.sibling_path, _descriptor.sibling_count);
+	}
+
 	const usb::device_descriptor &usb::find_valid_unique(const uint32_t _unique) const
 	{
-		for (auto const &i : descriptor)
+		for (size_t i = 0; i < descriptor_count; ++i)
 		{
-			if (i.device.is_valid() && i.device.get_unique() == _unique)
+			if (descriptor[i].device.is_valid() && descriptor[i].device.get_unique() == _unique)
 			{
-				return i;
+				return descriptor[i];
 			}
 		}
 
-		static const device_descriptor bad_choice;
+		static const device_descriptor bad_choice{};
 		return bad_choice;
 	}
 
 	void usb::list_devices()
 	{
-		if (descriptor.size() == 0)
+		VARIKEY_TRACE("list", 0);
+		if (descriptor_count == 0)
 		{
 			std::cout << "no devices found" << std::endl;
 		}
@@ -126,11 +312,12 @@ namespace wizard
 		{
 			std::cout << "list devices" << std::endl;
 		}
-		for (auto &i : descriptor)
+		for (size_t j = 0; j < descriptor_count; ++j)
 		{
+			device_descriptor &i = descriptor[j];
 			if (i.device.is_valid())
 			{
-				i.device.usb_open(i.device_path.c_str());
+				i.device.usb_open(i.device_path);
 				if (i.device.is_open())
 				{
 					int unique = i.device.get_unique();
@@ -143,6 +330,14 @@ namespace wizard
 					std::cout << std::hex << "hardware 0x" << hardware << "(" << std::dec << hardware << ") ";
 					std::cout << std::hex << "version 0x" << version << "(" << std::dec << version << ") ";
 					std::cout << i.device_path;
+					if (i.location.port[0] != '\0')
+					{
+						std::cout << " port " << i.location.port << " interface " << static_cast<int>(i.location.interface);
+					}
+					for (size_t k = 0; k < i.sibling_count; ++k)
+					{
+						std::cout << " " << i.sibling_path[k];
+					}
 					std::cout << std::endl;
 
 					i.device.usb_close();
@@ -150,4 +345,20 @@ namespace wizard
 			}
 		}
 	}
+
+	/**
+	 * @brief unique identifiers of all valid devices
+	 */
+	std::vector<uint32_t> usb::get_uniques() const
+	{
+		std::vector<uint32_t> uniques;
+		for (size_t i = 0; i < descriptor_count; ++i)
+		{
+			if (descriptor[i].device.is_valid())
+			{
+				uniques.push_back(descriptor[i].device.get_unique());
+			}
+		}
+		return uniques;
+	}
 }
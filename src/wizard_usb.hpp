@@ -9,12 +9,24 @@
 #ifndef __WIZARD_USB_HPP__
 #define __WIZARD_USB_HPP__
 
-#include <list>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "varikey_command.hpp"
 #include "varikey_device.hpp"
 #include "varikey_gadget_usb.hpp"
+#include "varikey_transport.hpp"
+
+/**
+ * @brief max number of expected hid devices for a scan
+ */
+#define WIZARD_DEVICE_LIMIT 16
+
+/**
+ * @brief max number of input interfaces beside the control interface
+ */
+#define WIZARD_SIBLING_LIMIT VARIKEY_INPUT_LIMIT
 
 namespace wizard
 {
@@ -25,22 +37,36 @@ namespace wizard
 		virtual ~usb();
 
 		int scan_devices(const std::string &);
+		void set_timeout(const uint64_t timeout);
+		void set_transport(std::shared_ptr<varikey::transport> link) { transport = link; }
 
 		varikey::gadget::usb &open_device(const uint32_t);
 		void close_device(varikey::gadget::usb &);
+		bool reconnect(varikey::gadget::usb &, const uint32_t timeout);
 
 		void list_devices();
+		std::vector<uint32_t> get_uniques() const;
 
 	private:
 		struct device_descriptor
 		{
-			std::string device_path;
+			char device_path[VARIKEY_PATH_SIZE];
 			varikey::gadget::usb device;
+			varikey::topology::location location{}; /* empty port without topology */
+			char sibling_path[WIZARD_SIBLING_LIMIT][VARIKEY_PATH_SIZE]; /* input interfaces */
+			size_t sibling_count{0};
 		};
 
-		std::list<device_descriptor> descriptor;
+		/* fixed pool, gadgets are created in place and never copied */
+		device_descriptor descriptor[WIZARD_DEVICE_LIMIT];
+		size_t descriptor_count{0};
+		char device_pattern[VARIKEY_PATH_SIZE - 2]{}; /* room for the node number */
+		uint64_t timeout{0};
+		std::shared_ptr<varikey::transport> transport{varikey::transport::hidraw()};
 
 		const device_descriptor &find_valid_unique(const uint32_t) const;
+		bool skip_node(const char *device_path, varikey::topology::location &) const;
+		void collect_siblings(device_descriptor &) const;
 	};
 }
 